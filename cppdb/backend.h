@@ -22,11 +22,14 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <vector>
 #include <typeinfo>
 #include <cppdb/defs.h>
 #include <cppdb/errors.h>
 #include <cppdb/ref_ptr.h>
 #include <cppdb/connection_specific.h>
+#include <cppdb/observer.h>
+#include <cppdb/stats.h>
 
 // Borland errors about unknown pool-type without this include.
 #ifdef __BORLANDC__
@@ -35,6 +38,8 @@
 
 namespace cppdb {
 	class connection_info;
+	class params;
+	class bulk_source;
 	// Borland needs pool.h, but not this forward declaration.
 	#ifndef __BORLANDC__
 	class pool;
@@ -205,11 +210,26 @@ namespace cppdb {
 			///
 			virtual std::string column_to_name(int) = 0;
 
+			///
+			/// Keep the object alive when its last reference is released, such that the statement
+			/// that created it can return it from the next query() call rather than allocating a new one.
+			/// ref_counted::use_count() equal to 0 means that the object is free for reuse.
+			///
+			/// The statement remains the owner: when it is destroyed it should delete the result if it is not
+			/// referenced, otherwise call keep_for_reuse(false) so the result is deleted with its last reference.
+			///
+			void keep_for_reuse(bool v);
+
 			result();
 			virtual ~result();
+
+			/// \cond INTERNAL
+			static void dispose(result *p);
+			/// \endcond
 		private:
 			struct data;
 			std::unique_ptr<data> d;
+			bool keep_for_reuse_;
 		};
 
 		class statements_cache;
@@ -382,11 +402,44 @@ namespace cppdb {
 			///
 			virtual void exec() = 0;
 
+			///
+			/// Send the statement to the server without waiting for its completion, so a following call
+			/// to query() or exec() only collects the result.
+			///
+			/// Returns false if the backend can't do this, in such a case nothing is sent and the statement
+			/// is executed as usual by query() or exec(). Default implementation returns false.
+			///
+			/// Once it returned true, no other operations should be done on the connection till the result is
+			/// collected. If the statement is reset or destroyed before that the result should be discarded.
+			///
+			/// Only waiting for the result is avoided, the statement itself may be sent using blocking writes.
+			///
+			virtual bool send_async();
+			///
+			/// Check without blocking if the result of the statement sent with send_async() had arrived, so
+			/// query() or exec() would not block. Default implementation returns true.
+			///
+			virtual bool async_ready();
+			///
+			/// Return the socket that becomes readable when the result of the statement sent with send_async()
+			/// arrives, or -1 if there is no such socket. Default implementation returns -1.
+			///
+			virtual int async_socket();
+
+			///
+			/// Bind all \a values to consecutive placeholders starting from \a first_col.
+			///
+			/// The text values are bound by reference, so \a values should remain valid until
+			/// the statement is executed.
+			///
+			void bind_params(int first_col,params const &values);
+
 			/// \cond INTERNAL 
 			// Caching support
 			static void dispose(statement *selfp);
 			
 			void cache(statements_cache *c);
+			int find_column(result &r,char const *name);
 			statement();
 			virtual ~statement() ;
 			/// \endcond
@@ -407,6 +460,10 @@ namespace cppdb {
 			void put(statement *p_in);
 			void clear();
 			ref_ptr<statement> fetch(std::string const &q);
+			ref_ptr<statement> fetch(char const *q);
+			statement_cache_stats stats();
+			// the counters changed since the previous call
+			statement_cache_stats collect();
 			~statements_cache();
 		private:
 			struct data;
@@ -500,6 +557,40 @@ namespace cppdb {
 		};
 
 
+		///
+		/// \brief Optional interface of a connection that can execute queries without blocking, so it
+		/// can be driven from an application event loop.
+		///
+		/// The backend::connection implementing it should inherit from this class as well, use dynamic_cast
+		/// to check if the connection supports it.
+		///
+		class CPPDB_API async_connection {
+		public:
+			///
+			/// Get the socket of the connection, it becomes readable when more data of the result of the query
+			/// started with start_query() arrives.
+			///
+			virtual int native_socket() = 0;
+			///
+			/// Send query \a q with parameters \a values to the server without waiting for its completion, the values
+			/// may be modified once the function returns.
+			///
+			/// Only one query can be in progress, no other operations should be done on the connection
+			/// till its result is received by poll_result()
+			///
+			virtual void start_query(std::string const &q,params const &values) = 0;
+			///
+			/// Read the data available on the socket without blocking. If the query is not completed returns false, otherwise
+			/// returns true and sets \a res to the query result and \a affected to the number of affected rows. If the query
+			/// does not return rows \a res is reset.
+			///
+			/// Throws cppdb_error if the query had failed.
+			///
+			virtual bool poll_result(ref_ptr<result> &res,unsigned long long &affected) = 0;
+
+			virtual ~async_connection() {}
+		};
+
 		///
 		/// \brief this class represents connection to database
 		///
@@ -516,9 +607,15 @@ namespace cppdb {
 			void set_driver(ref_ptr<loadable_driver> drv);
 			static void dispose(connection *c);
 			ref_ptr<statement> prepare(std::string const &q);
+			ref_ptr<statement> prepare(char const *q);
 			ref_ptr<statement> get_prepared_statement(std::string const &q);
+			ref_ptr<statement> get_prepared_statement(char const *q);
 			ref_ptr<statement> get_prepared_uncached_statement(std::string const &q);
 			ref_ptr<statement> get_statement(std::string const &q);
+			std::string const &affinity() const;
+			void affinity(std::string const &tag);
+			void warm_up(std::vector<std::string> const &queries);
+			statement_cache_stats collect_cache_stats();
 			/// \endcond 
 
 			// API 
@@ -548,6 +645,51 @@ namespace cppdb {
 			///
 			virtual statement *create_statement(std::string const &q) = 0;
 			///
+			/// Create prepared statements for all \a queries at once and append them to \a out.
+			///
+			/// It is used for warming up new pooled connections with the statements that are frequently
+			/// used by the application, so backends that can send several requests without waiting
+			/// for each reply should override it. Queries that fail to prepare should be silently skipped,
+			/// an exception should be thrown only if the connection itself is unusable.
+			///
+			/// Default implementation calls prepare_statement() for each query.
+			///
+			virtual void prepare_statements(std::vector<std::string> const &queries,std::vector<statement *> &out);
+			///
+			/// Insert all rows provided by \a source into \a table, the values of each row go to \a columns
+			/// in the same order. Returns the number of inserted rows.
+			///
+			/// The table and the column names are used as is, they are not escaped.
+			///
+			/// Default implementation executes multi-row INSERT statements, reported to the observers
+			/// like any other statement, backends that have faster ways to load data should override it.
+			/// The load is not atomic: unless it runs in a transaction, a failure may leave a part of the rows inserted.
+			///
+			virtual unsigned long long bulk_load(std::string const &table,std::vector<std::string> const &columns,bulk_source &source);
+			///
+			/// Write the content of the blob stored in \a column of \a table in the row \a rowid to \a out
+			/// by chunks, without loading the entire value to memory.
+			///
+			/// Default implementation throws not_supported_by_backend.
+			///
+			virtual void blob_read(std::string const &table,std::string const &column,long long rowid,std::ostream &out);
+			///
+			/// Overwrite the content of the existing blob stored in \a column of \a table in the row \a rowid
+			/// with the data read from \a in by chunks. The blob should already have the required size.
+			///
+			/// Default implementation throws not_supported_by_backend.
+			///
+			virtual void blob_write(std::string const &table,std::string const &column,long long rowid,std::istream &in);
+			///
+			/// Rewrite INSERT statement \a q so it returns the value of \a column generated for the new row as a single
+			/// row result, for example using INSERT ... RETURNING or OUTPUT INSERTED syntax.
+			///
+			/// Returns an empty string if the engine does not support it, this is the default.
+			///
+			/// \a q is passed without trailing white space and ';', it must not end with a comment.
+			///
+			virtual std::string returning_query(std::string const &q,std::string const &column);
+			///
 			/// Escape a string for inclusion in SQL query. May throw not_supported_by_backend() if not supported by backend.
 			///
 			virtual std::string escape(std::string const &) = 0;
@@ -573,6 +715,10 @@ namespace cppdb {
 			/// Clear statements cache
 			///
 			void clear_cache();
+			///
+			/// Get the counters of the prepared statements cache of this connection
+			///
+			statement_cache_stats cache_stats();
 
 			///
 			/// Check if session specific preparations are done
@@ -618,6 +764,34 @@ namespace cppdb {
 			/// 
 			void recyclable(bool value);
 
+			///
+			/// Add an observer notified about the queries executed over this connection. Note
+			/// that the observer remains installed when the connection is returned to the pool.
+			///
+			void add_observer(std::shared_ptr<query_observer> const &o);
+			///
+			/// Remove the observer \a o installed with add_observer()
+			///
+			void remove_observer(query_observer *o);
+			///
+			/// Check if there are observers installed for this connection or globally, so
+			/// events should be created
+			///
+			bool observed() const;
+			///
+			/// Notify the observers of this connection and the global observers about the event \a e
+			///
+			void notify(query_event const &e);
+			///
+			/// Capture the values bound to the statements of this connection for the observers, see
+			/// query_event::values. It is enabled automatically by \c \@slow_query_ms
+			///
+			void capture_params(bool v);
+			///
+			/// Check if the values bound to the statements of this connection are captured
+			///
+			bool capture_params() const;
+
 		private:
 
 			struct data;
@@ -61,10 +61,35 @@ namespace cppdb {
 		///
 		ref_ptr<backend::connection> open(connection_info const &ci);
 		///
+		/// Create a new connection using connection string \a cs, if the connection is pooled prefer
+		/// the one that had recently served the same \a affinity tag, see pool::open(std::string const &)
+		///
+		ref_ptr<backend::connection> open(std::string const &cs,std::string const &affinity);
+		///
+		/// Create a new connection using parsed connection string \a ci, if the connection is pooled prefer
+		/// the one that had recently served the same \a affinity tag, see pool::open(std::string const &)
+		///
+		ref_ptr<backend::connection> open(connection_info const &ci,std::string const &affinity);
+		///
+		/// Get the writer connection for connection string \a cs, see pool::open_writer()
+		///
+		ref_ptr<backend::connection> open_writer(std::string const &cs);
+		///
+		/// Get the writer connection for parsed connection string \a ci, see pool::open_writer()
+		///
+		ref_ptr<backend::connection> open_writer(connection_info const &ci);
+		///
 		/// Collect all connections that were not used for long time and close them.
 		///
 		void gc();
+		///
+		/// Get all the connection pools of the manager by their connection strings, for example
+		/// to collect their pool::stats()
+		///
+		std::map<std::string,ref_ptr<pool> > pools();
 	private:
+		ref_ptr<pool> get_pool(connection_info const &ci);
+
 		struct data;
 		std::unique_ptr<data> d;
 
@@ -0,0 +1,229 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPDB_CORO_H
+#define CPPDB_CORO_H
+
+#include <cppdb/frontend.h>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <functional>
+
+namespace cppdb {
+	///
+	/// \brief C++20 coroutines support, available when the compiler supports coroutines.
+	///
+	/// The awaitables suspend the coroutine while the statement is executed by the server and resume it
+	/// from the application's event loop, represented by the reactor interface, so a few threads can run
+	/// many concurrent queries. See \ref stat_coro
+	///
+	namespace coro {
+
+		///
+		/// \brief The interface of an application event loop the coroutines are resumed from.
+		///
+		class reactor {
+		public:
+			///
+			/// Call \a callback once, from the event loop, when the socket \a fd becomes readable
+			///
+			virtual void wait_readable(int fd,std::function<void()> callback) = 0;
+			///
+			/// Call \a callback once, from the event loop, as soon as possible
+			///
+			virtual void post(std::function<void()> callback) = 0;
+
+			virtual ~reactor() {}
+		};
+
+		/// \cond INTERNAL
+		namespace details {
+			class statement_awaitable {
+			public:
+				statement_awaitable(statement &st,reactor &r) : st_(st), reactor_(r)
+				{
+				}
+				// backends without asynchronous execution run the statement in await_resume()
+				bool await_ready()
+				{
+					return !st_.send_async();
+				}
+				bool await_suspend(std::coroutine_handle<> h)
+				{
+					if(st_.async_ready())
+						return false;
+					wait(h);
+					return true;
+				}
+			protected:
+				statement &st_;
+			private:
+				void wait(std::coroutine_handle<> h)
+				{
+					int fd = st_.async_socket();
+					std::function<void()> resume = [this,h]() {
+						bool ready = true;
+						try {
+							ready = st_.async_ready();
+						}
+						catch(...) {
+							// the error is reported by await_resume()
+						}
+						if(ready)
+							h.resume();
+						else
+							wait(h);
+					};
+					if(fd < 0)
+						reactor_.post(std::move(resume));
+					else
+						reactor_.wait_readable(fd,std::move(resume));
+				}
+				reactor &reactor_;
+			};
+		}
+		/// \endcond
+
+		///
+		/// \brief Awaitable returned by exec(), gives the number of affected rows
+		///
+		class exec_awaitable : public details::statement_awaitable {
+		public:
+			exec_awaitable(statement &st,reactor &r) : details::statement_awaitable(st,r)
+			{
+			}
+			unsigned long long await_resume()
+			{
+				st_.exec();
+				return st_.affected();
+			}
+		};
+
+		///
+		/// \brief Awaitable returned by query(), gives the query result
+		///
+		class query_awaitable : public details::statement_awaitable {
+		public:
+			query_awaitable(statement &st,reactor &r) : details::statement_awaitable(st,r)
+			{
+			}
+			result await_resume()
+			{
+				return st_.query();
+			}
+		};
+
+		///
+		/// Execute statement \a st, the coroutine is resumed from reactor \a r when it completes:
+		///
+		/// \code
+		/// unsigned long long rows = co_await cppdb::coro::exec(st,loop);
+		/// \endcode
+		///
+		/// The statement must remain valid till the coroutine is resumed. Backends that can't execute statements
+		/// asynchronously execute it without suspending the coroutine.
+		///
+		inline exec_awaitable exec(statement &st,reactor &r)
+		{
+			return exec_awaitable(st,r);
+		}
+		///
+		/// Execute query \a st, the coroutine is resumed from reactor \a r when the result is ready:
+		///
+		/// \code
+		/// cppdb::result res = co_await cppdb::coro::query(st,loop);
+		/// \endcode
+		///
+		/// The statement must remain valid till the coroutine is resumed. Backends that can't execute statements
+		/// asynchronously execute it without suspending the coroutine.
+		///
+		inline query_awaitable query(statement &st,reactor &r)
+		{
+			return query_awaitable(st,r);
+		}
+
+		///
+		/// \brief Iterates over a result giving the event loop a chance to run other coroutines every \a batch rows,
+		/// so processing of a large result does not starve them
+		///
+		/// \code
+		/// cppdb::coro::cursor c(res,loop);
+		/// while(co_await c.next()) {
+		///   ...
+		/// }
+		/// \endcode
+		///
+		class cursor {
+		public:
+			///
+			/// \brief Awaitable returned by next(), gives the result of result::next()
+			///
+			class next_awaitable {
+			public:
+				next_awaitable(cursor &c) : c_(c)
+				{
+				}
+				bool await_ready()
+				{
+					return c_.fetched_ < c_.batch_;
+				}
+				void await_suspend(std::coroutine_handle<> h)
+				{
+					c_.fetched_ = 0;
+					c_.reactor_.post([h]() { h.resume(); });
+				}
+				bool await_resume()
+				{
+					c_.fetched_++;
+					return c_.res_.next();
+				}
+			private:
+				cursor &c_;
+			};
+
+			///
+			/// Iterate over \a res, yielding to the reactor \a r every \a batch rows
+			///
+			cursor(result &res,reactor &r,unsigned batch = 128) :
+				res_(res),
+				reactor_(r),
+				batch_(batch > 0 ? batch : 1),
+				fetched_(0)
+			{
+			}
+			///
+			/// Move to the next row, same as result::next()
+			///
+			next_awaitable next()
+			{
+				return next_awaitable(*this);
+			}
+		private:
+			result &res_;
+			reactor &reactor_;
+			unsigned batch_;
+			unsigned fetched_;
+		};
+
+	} // coro
+} // cppdb
+
+#endif
+
+#endif
@@ -20,6 +20,7 @@
 #include <cppdb/defs.h>
 #include <cppdb/errors.h>
 #include <cppdb/ref_ptr.h>
+#include <cppdb/params.h>
 
 // Borland errors about unknown pool-type without this include.
 #ifdef __BORLANDC__
@@ -30,6 +31,9 @@
 #include <ctime>
 #include <string>
 #include <memory>
+#include <vector>
+#include <functional>
+#include <future>
 #include <typeinfo>
 
 ///
@@ -43,6 +47,8 @@ namespace cppdb {
 	class session;
 	class connection_info;
 	class connection_specific_data;
+	class query_observer;
+	struct statement_cache_stats;
 
 	///
 	/// Get CppDB Version String. It consists of "A.B.C", where A
@@ -225,6 +231,14 @@ namespace cppdb {
 		/// copy of the reference
 		///
 		result const &operator=(result const &);
+		///
+		/// Move result, \a other becomes empty
+		///
+		result(result &&) noexcept;
+		///
+		/// Move assign result, \a other becomes empty
+		///
+		result const &operator=(result &&);
 
 		///
 		/// Return the number of columns in the result
@@ -248,6 +262,20 @@ namespace cppdb {
 		/// Convert column name \a n to its index, returns -1 if the name is not valid.
 		///
 		int find_column(std::string const &name);
+		///
+		/// Convert column name \a n to its index, throws invalid_column if the name is not valid.
+		///
+		/// Unlike index(std::string const &) it does not create a string object. The names of the columns
+		/// are indexed once per statement and the index is kept for further executions of the same
+		/// prepared statement.
+		///
+		int index(char const *n);
+		///
+		/// Convert column name \a n to its index, returns -1 if the name is not valid.
+		///
+		/// \copydetails index(char const *)
+		///
+		int find_column(char const *name);
 
 		///
 		/// Convert column index to column name, throws invalid_column if col is not in range 0<= col < cols()
@@ -262,6 +290,10 @@ namespace cppdb {
 		/// Return true if the column named \a n has NULL value
 		///
 		bool is_null(std::string const &n);
+		///
+		/// Return true if the column named \a n has NULL value
+		///
+		bool is_null(char const *n);
 
 		///
 		/// Clears the result, no further use of the result should be done until it is assigned again with a new statement result.
@@ -420,6 +452,62 @@ namespace cppdb {
 		/// the \a n value is invalid throws invalid_column exception
 		///
 		bool fetch(std::string const &n,std::ostream &v);
+		///
+		/// Same as fetch(std::string const &,short &) but does not create a string object for column name.
+		///
+		bool fetch(char const *n,short &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,unsigned short &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,int &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,unsigned &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,long &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,unsigned long &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,long long &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,unsigned long long &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,float &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,double &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,long double &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,std::string &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,std::tm &v);
+		///
+		/// \copydoc fetch(char const *,short&)
+		///
+		bool fetch(char const *n,std::ostream &v);
 
 
 		///
@@ -511,6 +599,30 @@ namespace cppdb {
 			return v;
 		}
 
+		///
+		/// \copydoc get(std::string const &)
+		///
+		template<typename T>
+		T get(char const *name)
+		{
+			T v=T();
+			if(!fetch(name,v))
+				throw null_value_fetch();
+			return v;
+		}
+
+		///
+		/// \copydoc get(std::string const &,T const &)
+		///
+		template<typename T>
+		T get(char const *name, T const &def)
+		{
+			T v=T();
+			if(!fetch(name,v))
+				return def;
+			return v;
+		}
+
 		///
 		/// Get a value of type \a T from column \a col (starting from 0). If the column
 		/// is null throws null_value_fetch(), if the column index is invalid throws invalid_column,
@@ -627,6 +739,14 @@ namespace cppdb {
 		/// backend::statement by two different statement objects.
 		///
 		statement const &operator=(statement const &);
+		///
+		/// Move a statement, \a other becomes empty
+		///
+		statement(statement &&) noexcept;
+		///
+		/// Move assign a statement, \a other becomes empty
+		///
+		statement const &operator=(statement &&);
 
 		///
 		/// Reset the statement - remove all bindings and return it into initial state so query() or exec()
@@ -731,6 +851,13 @@ namespace cppdb {
 		/// If placeholder was not binded the behavior is undefined and may vary between different backends.
 		///
 		statement &bind_null();
+		///
+		/// Bind all the \a values to the placeholders starting from the next one, the text values
+		/// are bound by reference.
+		///
+		/// Note: \a values MUST remain valid until the statement is queried or executed!
+		///
+		statement &bind(params const &values);
 
 // Without the following statement &operator<<(T v) errors for tags::use_tag<T> as T.
 #ifdef __BORLANDC__
@@ -878,6 +1005,44 @@ namespace cppdb {
 		///
 		void exec();
 
+		///
+		/// Execute a query without blocking the calling thread, the future gets its result or the thrown exception.
+		///
+		/// Backends that can send a statement without waiting for its completion (PostgreSQL) start the query immediately
+		/// and return a deferred future: the result is collected by the thread calling get() or wait(). Other backends
+		/// run the query on an internal worker pool; when the pool is overloaded the query is executed by
+		/// the calling thread.
+		///
+		/// The session, the statement and any value bound by reference MUST NOT be used or modified till the future
+		/// is ready. See \ref stat_async
+		///
+		std::future<result> query_async();
+		///
+		/// Execute a statement without blocking the calling thread, the future gets the number of affected rows or the thrown
+		/// exception. See query_async() for details.
+		///
+		std::future<unsigned long long> exec_async();
+
+		///
+		/// Low level API for integration with event loops: send the statement to the server without waiting for its
+		/// completion, so following query() or exec() call would only collect the result.
+		///
+		/// Returns false if the backend does not support it, in such a case nothing is sent and query() or exec()
+		/// executes the statement as usual. Sending a large statement may still block till the server reads it.
+		/// See \ref stat_async
+		///
+		bool send_async();
+		///
+		/// Check without blocking if the result of the statement sent with send_async() is available, so
+		/// query() or exec() would not block.
+		///
+		bool async_ready();
+		///
+		/// Get the socket that becomes readable when more data of the result of the statement sent with send_async() arrives,
+		/// returns -1 if there is no such socket.
+		///
+		int async_socket();
+
 		///
 		/// Same as bind(v);
 		///
@@ -895,6 +1060,10 @@ namespace cppdb {
 		///
 		statement &operator<<(std::istream &v);
 		///
+		/// Same as bind(values);
+		///
+		statement &operator<<(params const &values);
+		///
 		/// Apply manipulator on the statement, same as manipulator(*this).
 		///
 		statement &operator<<(void (*manipulator)(statement &st));
@@ -932,10 +1101,14 @@ namespace cppdb {
 		
 	private:
 		statement(ref_ptr<backend::statement> stat,ref_ptr<backend::connection> conn);
+		void bound(int col);
+		int bound_params() const;
 
 		friend class session;
 
 		int placeholder_;
+		// the highest placeholder bound using bind(col,v)
+		int max_col_;
 		ref_ptr<backend::statement> stat_;
 		ref_ptr<backend::connection> conn_;
 		struct data;
@@ -1013,6 +1186,14 @@ namespace cppdb {
 		///
 		session const &operator=(session const &);
 		///
+		/// Move a session object, \a other becomes closed
+		///
+		session(session &&) noexcept;
+		///
+		/// Move assign a session object, \a other becomes closed
+		///
+		session const &operator=(session &&);
+		///
 		/// Destroys the session object, if connection pool is used it returns the object to connection pool.
 		///
 		/// Note: the connection would not be returned to the pool until all statement and result objects
@@ -1086,6 +1267,34 @@ namespace cppdb {
 		///
 		void open(std::string const &cs);
 		///
+		/// Open a session using a connection_info object - parsed connection string \a ci, if the
+		/// connection is pooled prefer the one that had recently served the same \a affinity tag.
+		///
+		/// See \ref pool_affinity
+		///
+		void open(connection_info const &ci,std::string const &affinity);
+		///
+		/// Open a session using a connection string \a cs, if the
+		/// connection is pooled prefer the one that had recently served the same \a affinity tag.
+		///
+		/// See \ref pool_affinity
+		///
+		void open(std::string const &cs,std::string const &affinity);
+		///
+		/// Open a session using the connection that should be used for modifying the database, when the pool
+		/// is created with \c \@pool_mode=single_writer open() gives read only connections.
+		///
+		/// See \ref pool_single_writer
+		///
+		void open_writer(connection_info const &ci);
+		///
+		/// Open a session using the connection that should be used for modifying the database, when the pool
+		/// is created with \c \@pool_mode=single_writer open() gives read only connections.
+		///
+		/// See \ref pool_single_writer
+		///
+		void open_writer(std::string const &cs);
+		///
 		/// Close current connection, note, if connection pooling is used the connection is not actually become closed but
 		/// rather recycled for future use.
 		///
@@ -1102,6 +1311,54 @@ namespace cppdb {
 		/// This is the most convenient function to create statements with.
 		///
 		statement prepare(std::string const &query);
+		///
+		/// Same as prepare(std::string const &) but does not create a copy of the query text
+		/// when the statement is found in the statements cache.
+		///
+		statement prepare(char const *query);
+		///
+		/// Write the blob stored in \a column of \a table in the row \a rowid to \a out by chunks, so the
+		/// entire value is never kept in memory.
+		///
+		/// Currently supported by sqlite3 backend only, other backends throw not_supported_by_backend. See \ref stat_blob
+		///
+		void blob_read(std::string const &table,std::string const &column,long long rowid,std::ostream &out);
+		///
+		/// Overwrite the blob stored in \a column of \a table in the row \a rowid with the data from \a in
+		/// by chunks. The blob can't change its size, so it should be created with the required size first,
+		/// for example by inserting zeroblob(N).
+		///
+		/// Currently supported by sqlite3 backend only, other backends throw not_supported_by_backend. See \ref stat_blob
+		///
+		void blob_write(std::string const &table,std::string const &column,long long rowid,std::istream &in);
+
+		///
+		/// Execute INSERT statement \a q with parameters \a values and return the id generated for column \a id_column.
+		///
+		/// If the backend supports INSERT ... RETURNING or OUTPUT INSERTED syntax the id is returned by the insert itself,
+		/// otherwise statement::sequence_last(\a sequence) is used after the insert, so \a sequence should be given
+		/// for engines that require it, like PostgreSQL. Trailing white space and ';' are removed from \a q,
+		/// but it must not end with a comment. See \ref stat_returning
+		///
+		long long insert_returning_id(std::string const &q,std::string const &id_column,params const &values,std::string const &sequence = std::string());
+
+		///
+		/// Insert all the rows provided by \a source into \a table, values of each row go to the \a columns
+		/// in the same order. Returns the number of inserted rows.
+		///
+		/// The table and the column names are used as is, they are not escaped.
+		///
+		/// The load is not atomic, if it fails some of the rows may already be inserted, so run it in a transaction
+		/// when all or none of the rows should be loaded. See \ref stat_bulk
+		///
+		unsigned long long bulk_load(std::string const &table,std::vector<std::string> const &columns,bulk_source &source);
+		///
+		/// Same as bulk_load(std::string const &,std::vector<std::string> const &,bulk_source &) with the rows
+		/// provided by function \a next_row that fills its parameter with the values of the next row and returns false
+		/// when no more rows remain.
+		///
+		unsigned long long bulk_load(std::string const &table,std::vector<std::string> const &columns,std::function<bool(params &)> const &next_row);
+
 		///
 		/// Syntactic sugar, same as prepare(q)
 		///
@@ -1197,6 +1454,22 @@ namespace cppdb {
 		/// 
 		void recyclable(bool value);
 
+		///
+		/// Add an observer notified about the queries executed over this session's connection, see \ref observers.
+		///
+		/// Note the observer remains installed when the connection is returned to the pool.
+		///
+		void add_observer(std::shared_ptr<query_observer> const &o);
+		///
+		/// Remove the observer \a o installed with add_observer()
+		///
+		void remove_observer(query_observer *o);
+		///
+		/// Get the counters of the prepared statements cache of this session's connection, see
+		/// \ref pool_stats. Requires \c <cppdb/stats.h>
+		///
+		statement_cache_stats cache_stats();
+
 		///
 		/// Returns true of session specific initialization is done, otherwise returns false
 		///
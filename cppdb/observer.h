@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPDB_OBSERVER_H
+#define CPPDB_OBSERVER_H
+
+#include <cppdb/defs.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cppdb {
+	namespace backend {
+		class connection;
+	}
+
+	///
+	/// \brief The information about a single step of a query execution passed to query_observer
+	///
+	struct query_event {
+		typedef std::chrono::steady_clock clock_type;
+
+		///
+		/// The type of the event
+		///
+		typedef enum {
+			prepare_event,		///< A statement was created or prepared
+			execute_event,		///< A statement was executed or a query result received
+			first_row_event,	///< The first row of a query result was fetched
+			close_event,		///< A query result was closed
+			error_event		///< An operation had failed, see \a operation
+		} event_type;
+
+		///
+		/// The type of the event
+		///
+		event_type type;
+		///
+		/// The operation the event refers to, same as \a type unless \a type is error_event where it is
+		/// the operation that had failed.
+		///
+		event_type operation;
+		///
+		/// The time the operation had started, for first_row_event and close_event it is the time the
+		/// query execution had started.
+		///
+		clock_type::time_point start;
+		///
+		/// The time of the event
+		///
+		clock_type::time_point time;
+		///
+		/// The SQL text of the statement, never NULL
+		///
+		char const *sql;
+		///
+		/// The number of the parameters bound to the statement: the highest placeholder bound using sequential bind(),
+		/// operator<< or bind() with an explicit placeholder number
+		///
+		int params;
+		///
+		/// True if the statement was executed using query() and returns rows, false if it was executed
+		/// using exec() or for prepare_event
+		///
+		bool is_query;
+		///
+		/// The number of rows fetched, for close_event and error_event of the fetch
+		///
+		unsigned long long rows;
+		///
+		/// The number of the affected rows, for execute_event of the statements executed with exec()
+		///
+		unsigned long long affected;
+		///
+		/// The error message for error_event, NULL otherwise
+		///
+		char const *error;
+		///
+		/// The text representation of the values bound to the statement, the first placeholder at index 0,
+		/// available only if the connection captures them, see backend::connection::capture_params(), NULL otherwise.
+		///
+		std::vector<std::string> const *values;
+		///
+		/// The connection the statement belongs to
+		///
+		backend::connection *conn;
+
+		///
+		/// Create an event of type \a t
+		///
+		query_event(event_type t = execute_event) :
+			type(t),
+			operation(t),
+			sql(""),
+			params(0),
+			is_query(false),
+			rows(0),
+			affected(0),
+			error(0),
+			values(0),
+			conn(0)
+		{
+		}
+		///
+		/// Get the duration of the operation - time - start
+		///
+		clock_type::duration duration() const
+		{
+			return time - start;
+		}
+	};
+
+	///
+	/// \brief The interface of an object notified about the queries execution, for collecting timing and other statistics.
+	///
+	/// The observer is called from the thread that uses the connection, an observer installed for many connections
+	/// or globally should be thread safe. The exceptions thrown by the observer are ignored.
+	///
+	/// See \ref observers
+	///
+	class query_observer {
+	public:
+		///
+		/// Called for each event
+		///
+		virtual void on_event(query_event const &e) = 0;
+
+		virtual ~query_observer() {}
+	};
+
+	///
+	/// Install an observer notified about the queries executed over all connections
+	///
+	CPPDB_API void add_global_observer(std::shared_ptr<query_observer> const &o);
+	///
+	/// Remove the global observer \a o installed with add_global_observer()
+	///
+	CPPDB_API void remove_global_observer(query_observer *o);
+}
+
+#endif
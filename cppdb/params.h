@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPDB_PARAMS_H
+#define CPPDB_PARAMS_H
+
+#include <cppdb/defs.h>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace cppdb {
+
+	///
+	/// \brief A list of values kept by copy, for binding them to a statement later.
+	///
+	/// It is used as a row of data for bulk loading and for statements executed by
+	/// other threads, where references to the original values can't be kept.
+	///
+	/// clear() keeps the allocated storage, so an object reused for many rows
+	/// does not allocate memory once it had seen the longest row.
+	///
+	class CPPDB_API params {
+	public:
+		///
+		/// The type of a stored value
+		///
+		typedef enum {
+			null_type,	///< NULL value
+			int_type,	///< signed integer, see as_int()
+			uint_type,	///< unsigned integer, see as_uint()
+			real_type,	///< floating point value, see as_real()
+			text_type,	///< text or blob, see as_text()
+			time_type	///< date-time, see as_time()
+		} value_type;
+
+		params();
+		~params();
+		params(params const &);
+		params const &operator=(params const &);
+		params(params &&) noexcept;
+		params const &operator=(params &&);
+
+		///
+		/// Number of values
+		///
+		size_t size() const;
+		///
+		/// Check if there are no values
+		///
+		bool empty() const;
+		///
+		/// Remove all values keeping allocated storage
+		///
+		void clear();
+
+		///
+		/// Add a NULL value
+		///
+		params &add_null();
+		///
+		/// Add a signed integer value
+		///
+		params &add(long long v);
+		///
+		/// Add an unsigned integer value
+		///
+		params &add(unsigned long long v);
+		///
+		/// Add a floating point value
+		///
+		params &add(double v);
+		///
+		/// Add a text value
+		///
+		params &add(std::string const &v);
+		///
+		/// Add a text value
+		///
+		params &add(char const *v);
+		///
+		/// Add a text value in range [\a b, \a e)
+		///
+		params &add(char const *b,char const *e);
+		///
+		/// Add a date-time value
+		///
+		params &add(std::tm const &v);
+
+		///
+		/// Syntactic sugar for add(long long)
+		///
+		params &operator<<(int v) { return add(static_cast<long long>(v)); }
+		///
+		/// Syntactic sugar for add(unsigned long long)
+		///
+		params &operator<<(unsigned v) { return add(static_cast<unsigned long long>(v)); }
+		///
+		/// Syntactic sugar for add(long long)
+		///
+		params &operator<<(long v) { return add(static_cast<long long>(v)); }
+		///
+		/// Syntactic sugar for add(unsigned long long)
+		///
+		params &operator<<(unsigned long v) { return add(static_cast<unsigned long long>(v)); }
+		///
+		/// Syntactic sugar for add(long long)
+		///
+		params &operator<<(long long v) { return add(v); }
+		///
+		/// Syntactic sugar for add(unsigned long long)
+		///
+		params &operator<<(unsigned long long v) { return add(v); }
+		///
+		/// Syntactic sugar for add(double)
+		///
+		params &operator<<(double v) { return add(v); }
+		///
+		/// Syntactic sugar for add(std::string const &)
+		///
+		params &operator<<(std::string const &v) { return add(v); }
+		///
+		/// Syntactic sugar for add(char const *)
+		///
+		params &operator<<(char const *v) { return add(v); }
+		///
+		/// Syntactic sugar for add(std::tm const &)
+		///
+		params &operator<<(std::tm const &v) { return add(v); }
+
+		///
+		/// Get the type of value \a i, starting from 0
+		///
+		value_type type(size_t i) const;
+		///
+		/// Get a signed integer value \a i, valid if type(i) is int_type
+		///
+		long long as_int(size_t i) const;
+		///
+		/// Get an unsigned integer value \a i, valid if type(i) is uint_type
+		///
+		unsigned long long as_uint(size_t i) const;
+		///
+		/// Get a floating point value \a i, valid if type(i) is real_type
+		///
+		double as_real(size_t i) const;
+		///
+		/// Get a text value \a i, valid if type(i) is text_type
+		///
+		std::string const &as_text(size_t i) const;
+		///
+		/// Get a date-time value \a i, valid if type(i) is time_type
+		///
+		std::tm const &as_time(size_t i) const;
+
+	private:
+		struct value {
+			value_type type;
+			union {
+				long long i;
+				unsigned long long u;
+				double r;
+			} number;
+			std::string text;
+			std::tm time;
+		};
+		value &next();
+		value const &at(size_t i) const;
+
+		struct data;
+		std::unique_ptr<data> d;
+		std::vector<value> values_;
+		size_t size_;
+	};
+
+	///
+	/// \brief A source of rows for bulk loading, see session::bulk_load()
+	///
+	/// The rows are pulled by the loader only when it is ready to send them, so the source
+	/// never needs to buffer the data by itself.
+	///
+	class CPPDB_API bulk_source {
+	public:
+		virtual ~bulk_source() {}
+		///
+		/// Put the values of the next row to \a row, it is passed cleared. Return false
+		/// if there are no more rows.
+		///
+		virtual bool next(params &row) = 0;
+	};
+
+}
+
+#endif
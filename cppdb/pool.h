@@ -22,8 +22,10 @@
 #include <cppdb/ref_ptr.h>
 #include <mutex>
 #include <cppdb/utils.h>
+#include <cppdb/stats.h>
 #include <memory>
 #include <list>
+#include <chrono>
 
 
 namespace cppdb {
@@ -32,6 +34,65 @@ namespace cppdb {
 		class connection;
 	}
 	
+	///
+	/// \brief The snapshot of the connection pool counters, see pool::stats()
+	///
+	struct pool_stats {
+		///
+		/// The number of connections taken from the pool
+		///
+		unsigned long long hits;
+		///
+		/// The number of times a new connection was opened because the pool had no idle one
+		///
+		unsigned long long misses;
+		///
+		/// The number of connections opened by the pool. The connections opened with \c \@pool_size=0
+		/// are not pooled and are not counted, except the writer of \c \@pool_mode=single_writer that
+		/// is always kept by the pool.
+		///
+		unsigned long long creates;
+		///
+		/// The number of connections closed by the pool, including the evicted ones and the ones that were
+		/// not returned because of an error
+		///
+		unsigned long long destroys;
+		///
+		/// The number of idle connections closed because they were not used for \c \@pool_max_idle seconds
+		///
+		unsigned long long evictions;
+		///
+		/// The current number of idle connections
+		///
+		size_t idle;
+		///
+		/// The current number of connections in use
+		///
+		size_t busy;
+		///
+		/// The number of connections given by open() and open_writer()
+		///
+		unsigned long long checkouts;
+		///
+		/// The median time of open() and open_writer() calls, including waiting for the writer and opening new connections
+		///
+		std::chrono::nanoseconds checkout_p50;
+		///
+		/// The 99th percentile of the time of open() and open_writer() calls
+		///
+		std::chrono::nanoseconds checkout_p99;
+		///
+		/// The longest open() and open_writer() call
+		///
+		std::chrono::nanoseconds checkout_max;
+		///
+		/// The prepared statements cache counters of all the connections of the pool, the counters of
+		/// a connection in use are added when it is returned to the pool. The size is the total size of the caches
+		/// of the idle connections.
+		///
+		statement_cache_stats statements;
+	};
+
 	///
 	/// \brief Connections pool, allows to handle multiple connections for specific connection string.
 	///
@@ -67,6 +128,29 @@ namespace cppdb {
 		///
 		ref_ptr<backend::connection> open();
 		///
+		/// Get a open a connection preferring the one that had recently served the same \a affinity tag.
+		///
+		/// The tag is any string that identifies a group of queries an application runs together,
+		/// for example a request handler name. Connections that executed these queries have their
+		/// prepared statements already cached, so reusing them avoids preparing them once again.
+		///
+		/// If no idle connection carries the tag, the most recently used one is taken, as open() does,
+		/// and it is tagged with \a affinity. Empty tag means no preference.
+		///
+		ref_ptr<backend::connection> open(std::string const &affinity);
+		///
+		/// Get the connection that should be used for modifying the database.
+		///
+		/// When the pool is created with \c \@pool_mode=single_writer, there is exactly one writer connection,
+		/// callers wait for it in the order they had called open_writer() until it is returned to the pool,
+		/// so writes never compete on database locks. Connections returned by open() are readers then,
+		/// for sqlite3 driver they are opened with \c mode=readonly and the writer sets WAL journal mode
+		/// unless \c journal_mode is given explicitly. See \ref pool_single_writer
+		///
+		/// In the default mode it is the same as open()
+		///
+		ref_ptr<backend::connection> open_writer();
+		///
 		/// Collect connections that were not used for a long time (close them)
 		///
 		void gc();
@@ -76,11 +160,22 @@ namespace cppdb {
 		///
 		void clear();
 
+		///
+		/// Get the current counters of the pool
+		///
+		pool_stats stats();
+
 		/// \cond INTERNAL
 		void put(backend::connection *c_in);
+		void discard(backend::connection *c);
+		void statement_prepared(std::string const &q);
 		/// \endcond
 	private:
-		ref_ptr<backend::connection> get();
+		void warm_up(backend::connection &c);
+		void setup_writer();
+		bool put_writer(backend::connection *c);
+
+		ref_ptr<backend::connection> get(std::string const &affinity);
 
 		struct data;
 		std::unique_ptr<data> d;
@@ -19,6 +19,7 @@
 #define CPPDB_REF_PTR_H
 #include <cppdb/errors.h>
 #include <atomic>
+#include <utility>
 
 namespace cppdb {
 	///
@@ -65,6 +66,33 @@ namespace cppdb {
 			reset(other.p);
 			return *this;
 		}
+		///
+		/// Move a pointer, \a other becomes empty, the reference count is not changed
+		///
+		ref_ptr(ref_ptr &&other) noexcept : p(other.p)
+		{
+			other.p = 0;
+		}
+		///
+		/// Move assign a pointer, \a other becomes empty, the reference count of the moved object is not changed
+		///
+		ref_ptr const &operator=(ref_ptr &&other)
+		{
+			if(this != &other) {
+				T *tmp = other.p;
+				other.p = 0;
+				reset();
+				p = tmp;
+			}
+			return *this;
+		}
+		///
+		/// Swap two pointers without changing reference counts
+		///
+		void swap(ref_ptr &other) noexcept
+		{
+			std::swap(p,other.p);
+		}
 		// Borland warns on assignments using operator=(ref_ptr...) with new sometype(...).
 		#ifdef __BORLANDC__
 		ref_ptr const &operator=(T *other)
@@ -149,7 +177,9 @@ namespace cppdb {
 		///
 		long add_ref()
 		{
-			return ++count_;
+			// a new reference can only be created from an existing one
+			// so no ordering is required
+			return count_.fetch_add(1,std::memory_order_relaxed) + 1;
 		}
 		///
 		/// Get reference count
@@ -164,7 +194,8 @@ namespace cppdb {
 		///
 		long del_ref()
 		{
-			return --count_;
+			// release our writes and acquire the others before possible destruction
+			return count_.fetch_sub(1,std::memory_order_acq_rel) - 1;
 		}
 		///
 		/// Delete the object
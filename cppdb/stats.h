@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPDB_STATS_H
+#define CPPDB_STATS_H
+
+#include <cppdb/defs.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+namespace cppdb {
+
+	class query_observer;
+
+	///
+	/// \brief The counters of the prepared statements cache, see session::cache_stats() and pool_stats
+	///
+	struct statement_cache_stats {
+		statement_cache_stats() :
+			hits(0),
+			misses(0),
+			evictions(0),
+			reprepares(0),
+			size(0),
+			capacity(0)
+		{
+		}
+		///
+		/// The number of prepared statements taken from the cache
+		///
+		unsigned long long hits;
+		///
+		/// The number of statements that were not found in the cache and had to be prepared
+		///
+		unsigned long long misses;
+		///
+		/// The number of the least recently used statements removed from the cache when it was full
+		///
+		unsigned long long evictions;
+		///
+		/// The number of misses of recently evicted statements, if it is high the cache is too small
+		///
+		unsigned long long reprepares;
+		///
+		/// The number of statements in the cache
+		///
+		size_t size;
+		///
+		/// The maximal number of statements in the cache, \c \@stmt_cache_size
+		///
+		size_t capacity;
+	};
+
+	///
+	/// \brief Lock free histogram of durations with logarithmic buckets, each one divided into
+	/// 16 linear sub-buckets, so the relative error of the reported values is about 3%.
+	///
+	/// The durations are recorded with nanoseconds resolution, values above about 9 hours are counted
+	/// in the last bucket. All member functions are thread safe.
+	///
+	class CPPDB_API latency_histogram {
+		latency_histogram(latency_histogram const &);
+		void operator=(latency_histogram const &);
+	public:
+		///
+		/// The number of the buckets
+		///
+		static int const buckets = 672;
+
+		///
+		/// Create an empty histogram
+		///
+		latency_histogram();
+		///
+		/// Add a duration \a d to the histogram
+		///
+		void record(std::chrono::nanoseconds d);
+		///
+		/// Get the number of the recorded values
+		///
+		unsigned long long count() const;
+		///
+		/// Get the sum of all the recorded values
+		///
+		std::chrono::nanoseconds total() const;
+		///
+		/// Get the largest recorded value
+		///
+		std::chrono::nanoseconds max_value() const;
+		///
+		/// Get the value below which \a p percent of the recorded values fall, for example percentile(99.9),
+		/// returns 0 if the histogram is empty.
+		///
+		std::chrono::nanoseconds percentile(double p) const;
+		///
+		/// Remove all the recorded values
+		///
+		void reset();
+
+		///
+		/// Get the index of the bucket value \a v (nanoseconds) is counted in
+		///
+		static int bucket(unsigned long long v);
+		///
+		/// Get the smallest value counted in the bucket \a index
+		///
+		static unsigned long long bucket_lower_bound(int index);
+	private:
+		std::atomic<unsigned long long> counts_[buckets];
+		std::atomic<unsigned long long> count_;
+		std::atomic<unsigned long long> total_;
+		std::atomic<unsigned long long> max_;
+	};
+
+	///
+	/// \brief Built-in per-query statistics, see \ref query_stats
+	///
+	namespace stats {
+		///
+		/// \brief Statistics of a single query shape
+		///
+		struct query_stats {
+			///
+			/// The normalized query text, see normalize_query()
+			///
+			std::string query;
+			///
+			/// The number of executions
+			///
+			unsigned long long executions;
+			///
+			/// The number of fetched rows
+			///
+			unsigned long long rows;
+			///
+			/// The number of failed preparations, executions and fetches
+			///
+			unsigned long long errors;
+			///
+			/// The total time of all executions
+			///
+			std::chrono::nanoseconds total;
+			///
+			/// The median latency
+			///
+			std::chrono::nanoseconds p50;
+			///
+			/// The 99th percentile of the latency
+			///
+			std::chrono::nanoseconds p99;
+			///
+			/// The 99.9th percentile of the latency
+			///
+			std::chrono::nanoseconds p999;
+			///
+			/// The largest latency
+			///
+			std::chrono::nanoseconds max;
+		};
+
+		///
+		/// Get the statistics of all the queries recorded so far, it is thread safe.
+		///
+		CPPDB_API std::vector<query_stats> snapshot();
+		///
+		/// Reset all the statistics
+		///
+		CPPDB_API void reset();
+		///
+		/// Get the shape of the query \a q - the query where the string and numeric literals are replaced with '?'
+		/// and the white space is collapsed, so the queries that differ only by inlined values have the same shape.
+		///
+		CPPDB_API std::string normalize_query(std::string const &q);
+		///
+		/// Get the observer that records the statistics, it is installed automatically for connections
+		/// opened with \c \@query_stats=on, but can be also installed using add_global_observer()
+		///
+		CPPDB_API std::shared_ptr<query_observer> observer();
+
+		///
+		/// \brief A query that took longer than the \c \@slow_query_ms threshold, see \ref slow_queries
+		///
+		struct slow_query {
+			slow_query() : rows(0), affected(0) {}
+			///
+			/// The SQL text of the statement
+			///
+			std::string sql;
+			///
+			/// The text representation of the bound values, the first placeholder at index 0, the strings are
+			/// quoted and truncated to 256 characters.
+			///
+			std::vector<std::string> params;
+			///
+			/// The driver of the connection, see backend::connection::driver()
+			///
+			std::string driver;
+			///
+			/// The database engine of the connection, see backend::connection::engine()
+			///
+			std::string engine;
+			///
+			/// The time spent preparing the statement, 0 if it was taken from the statements cache
+			///
+			std::chrono::nanoseconds prepare;
+			///
+			/// The time of exec() or query()
+			///
+			std::chrono::nanoseconds execute;
+			///
+			/// The time from the end of query() till the result was closed, 0 for exec()
+			///
+			std::chrono::nanoseconds fetch;
+			///
+			/// The number of fetched rows
+			///
+			unsigned long long rows;
+			///
+			/// The number of affected rows for exec()
+			///
+			unsigned long long affected;
+			///
+			/// The error message if the execution had failed, empty otherwise
+			///
+			std::string error;
+
+			///
+			/// Get the total time - prepare + execute + fetch
+			///
+			std::chrono::nanoseconds total() const
+			{
+				return prepare + execute + fetch;
+			}
+		};
+
+		///
+		/// \brief The destination of the slow queries log
+		///
+		class slow_query_sink {
+		public:
+			///
+			/// Record the query \a q, it is called from the thread that executed the query so the implementation
+			/// should be thread safe.
+			///
+			virtual void write(slow_query const &q) = 0;
+
+			virtual ~slow_query_sink() {}
+		};
+
+		///
+		/// Set the destination of the slow queries log, NULL restores the default one that writes
+		/// a line per query to the standard error.
+		///
+		CPPDB_API void set_slow_query_sink(std::shared_ptr<slow_query_sink> const &s);
+		///
+		/// Format the slow query \a q as a single line of text, as written by the default sink
+		///
+		CPPDB_API std::string format_slow_query(slow_query const &q);
+		///
+		/// Create an observer that writes the queries of a single connection that took longer than
+		/// \a threshold to the slow queries sink. It is installed automatically for connections opened with
+		/// \c \@slow_query_ms. The observer keeps the state of the connection, so it should not be shared
+		/// between connections, and it requires backend::connection::capture_params() for reporting the values.
+		///
+		CPPDB_API std::shared_ptr<query_observer> slow_query_observer(std::chrono::nanoseconds threshold);
+	}
+}
+
+#endif
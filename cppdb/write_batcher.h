@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPDB_WRITE_BATCHER_H
+#define CPPDB_WRITE_BATCHER_H
+
+#include <cppdb/defs.h>
+#include <cppdb/params.h>
+#include <string>
+#include <memory>
+#include <future>
+
+namespace cppdb {
+
+	///
+	/// \brief Group commit of many small independent modifications
+	///
+	/// Statements submitted from any number of threads are collected and executed by a background
+	/// thread in a single transaction, once \a max_statements are pending or \a max_delay_ms milliseconds
+	/// passed since the first of them was submitted. This way the price of a commit (fsync, network round trip)
+	/// is paid once per batch rather than once per statement, for a little extra latency.
+	///
+	/// If the batch transaction fails, it is rolled back and each statement of the batch is executed once again
+	/// on its own, so the failure of one statement is reported only to its submitter.
+	///
+	/// The connection is opened using session::open_writer() for each batch, so the connection string would
+	/// usually contain \c \@pool_size option.
+	///
+	/// All member functions are thread safe. See \ref stat_batch
+	///
+	class CPPDB_API write_batcher {
+		write_batcher(write_batcher const &);
+		void operator=(write_batcher const &);
+	public:
+		///
+		/// Create a new batcher executing statements on connections given by \a connection_string
+		///
+		write_batcher(std::string const &connection_string,size_t max_statements = 100,int max_delay_ms = 10);
+		///
+		/// Execute all pending statements and stop the background thread
+		///
+		~write_batcher();
+
+		///
+		/// Submit a statement \a query with parameters \a values for execution, the result is the number
+		/// of affected rows, or the exception thrown by the statement.
+		///
+		std::future<unsigned long long> submit(std::string const &query,params const &values = params());
+		///
+		/// Submit a statement \a query with parameters \a values for execution, the result is the number
+		/// of affected rows, or the exception thrown by the statement.
+		///
+		std::future<unsigned long long> submit(std::string const &query,params &&values);
+
+		///
+		/// Execute all the statements submitted so far without waiting for the timeout and wait for them
+		///
+		void flush();
+
+	private:
+		void run();
+		struct data;
+		std::unique_ptr<data> d;
+	};
+}
+
+#endif
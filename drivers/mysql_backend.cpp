@@ -20,12 +20,17 @@
 # define CPPDB_SOURCE
 #endif
 #include <mysql.h>
+#include <errmsg.h>
 
 #include <cppdb/backend.h>
 #include <cppdb/errors.h>
 #include <cppdb/utils.h>
 #include <cppdb/numeric_util.h>
+#include <cppdb/params.h>
 #include <sstream>
+#include <exception>
+#include <locale>
+#include <stdio.h>
 #include <vector>
 #include <limits>
 #include <iomanip>
@@ -245,6 +250,27 @@ namespace unprep {
 			row_(0)
 		{
 			fmt_.imbue(std::locale::classic());
+			store(conn);
+		}
+		// prepare the object kept by the statement for the next query
+		void reuse(MYSQL *conn)
+		{
+			if(res_) {
+				mysql_free_result(res_);
+				res_ = 0;
+			}
+			current_row_ = 0;
+			row_ = 0;
+			store(conn);
+		}
+		~result()
+		{
+			if(res_)
+				mysql_free_result(res_);
+		}
+	private:
+		void store(MYSQL *conn)
+		{
 			res_ = mysql_store_result(conn);
 			if(!res_) {
 				cols_ = mysql_field_count(conn);
@@ -254,14 +280,8 @@ namespace unprep {
 			else {
 				cols_ = mysql_num_fields(res_);
 			}
-
 		}
-		~result()
-		{
-			if(res_)
-				mysql_free_result(res_);
-		}
-	private:
+
 		std::istringstream fmt_;
 		MYSQL_RES *res_;
 		int cols_;
@@ -392,6 +412,16 @@ namespace unprep {
 			if(mysql_real_query(conn_,real_query.c_str(),real_query.size())) {
 				throw cppdb_myerror(mysql_error(conn_));
 			}
+			if(!result_) {
+				result_ = new result(conn_);
+				result_->keep_for_reuse(true);
+				return result_;
+			}
+			if(result_->use_count() == 0) {
+				result_->reuse(conn_);
+				return result_;
+			}
+			// previous result is still referenced
 			return new result(conn_);
 		}
 		
@@ -426,7 +456,8 @@ namespace unprep {
 		statement(std::string const &q,MYSQL *conn) :
 			query_(q),
 			conn_(conn),
-			params_no_(0)
+			params_no_(0),
+			result_(0)
 		{
 			fmt_.imbue(std::locale::classic());
 			bool inside_text = false;
@@ -446,6 +477,12 @@ namespace unprep {
 		}
 		virtual ~statement()
 		{
+			if(result_) {
+				if(result_->use_count() == 0)
+					delete result_;
+				else
+					result_->keep_for_reuse(false);
+			}
 		}
 		virtual void reset()
 		{
@@ -459,6 +496,8 @@ namespace unprep {
 		std::string query_;
 		MYSQL *conn_;
 		int params_no_;
+		// kept for reuse by the next query
+		result *result_;
 	};
 } // uprep
 
@@ -752,6 +791,20 @@ namespace prep {
 			stmt_(stmt), current_row_(0),meta_(0)
 		{
 			fmt_.imbue(std::locale::classic());
+			store();
+		}
+		// prepare the object kept by the statement for the next query
+		void reuse()
+		{
+			if(meta_) {
+				mysql_free_result(meta_);
+				meta_ = 0;
+			}
+			current_row_ = 0;
+			store();
+		}
+		void store()
+		{
 			cols_ = mysql_stmt_field_count(stmt_);
 			if(mysql_stmt_store_result(stmt_)) {
 				throw cppdb_myerror(mysql_stmt_error(stmt_));
@@ -763,7 +816,8 @@ namespace prep {
 		}
 		~result()
 		{
-			mysql_free_result(meta_);
+			if(meta_)
+				mysql_free_result(meta_);
 		}
 		void reset()
 		{
@@ -792,49 +846,106 @@ namespace prep {
 	};
 
 	class statement : public backend::statement {
+		//
+		// Values are kept in a native form inside the param object, so the pointers
+		// in MYSQL_BIND remain valid across executions.
+		//
 		struct param {
+			enum_field_types type;
 			bool is_null;
-			bool is_blob;
+			bool is_unsigned;
 			unsigned long length;
-			std::string value;
 			void *buffer;
+			union {
+				long long ll;
+				unsigned long long ull;
+				double d;
+			} number;
+			MYSQL_TIME time;
+			std::string value;
 			param() : 
+				type(MYSQL_TYPE_NULL),
 				is_null(1),
-				is_blob(false),
+				is_unsigned(false),
 				length(0),
 				buffer(0)
 			{
+				number.ull = 0;
+				memset(&time,0,sizeof(time));
+			}
+			void set_null()
+			{
+				type = MYSQL_TYPE_NULL;
+				is_null = 1;
+				is_unsigned = false;
+				length = 0;
+				buffer = 0;
 			}
 			void set(char const *b,char const *e,bool blob=false)
 			{
+				type = blob ? MYSQL_TYPE_BLOB : MYSQL_TYPE_STRING;
 				length = e - b;
 				buffer = const_cast<char *>(b);
-				is_blob = blob;
+				is_unsigned = false;
 				is_null = 0;
 			}
-			void set_str(std::string const &s)
+			void set_str(std::string const &s,bool blob=false)
 			{
 				value = s;
-				buffer = const_cast<char *>(value.c_str());
-				length = value.size();
+				set(value.c_str(),value.c_str()+value.size(),blob);
+			}
+			void set(long long v)
+			{
+				type = MYSQL_TYPE_LONGLONG;
+				number.ll = v;
+				buffer = &number;
+				length = sizeof(v);
+				is_unsigned = false;
+				is_null = 0;
+			}
+			void set(unsigned long long v)
+			{
+				set(static_cast<long long>(0));
+				number.ull = v;
+				is_unsigned = true;
+			}
+			void set(double v)
+			{
+				type = MYSQL_TYPE_DOUBLE;
+				number.d = v;
+				buffer = &number;
+				length = sizeof(v);
+				is_unsigned = false;
 				is_null = 0;
 			}
 			void set(std::tm const &t)
 			{
-				set_str(cppdb::format_time(t));
+				memset(&time,0,sizeof(time));
+				time.year = t.tm_year + 1900;
+				time.month = t.tm_mon + 1;
+				time.day = t.tm_mday;
+				time.hour = t.tm_hour;
+				time.minute = t.tm_min;
+				time.second = t.tm_sec;
+				time.time_type = MYSQL_TIMESTAMP_DATETIME;
+				type = MYSQL_TYPE_DATETIME;
+				buffer = &time;
+				length = sizeof(time);
+				is_unsigned = false;
+				is_null = 0;
 			}
-			void bind_it(MYSQL_BIND *b) 
+			// returns true if the binding had changed and should be passed to mysql_stmt_bind_param
+			bool bind_it(MYSQL_BIND *b) 
 			{
+				if(b->buffer_type == type && b->buffer == buffer && bool(b->is_unsigned) == is_unsigned && b->is_null == &is_null)
+					return false;
 				b->is_null = &is_null;
-				if(!is_null) {
-					b->buffer_type = is_blob ? MYSQL_TYPE_BLOB : MYSQL_TYPE_STRING;
-					b->buffer = buffer;
-					b->buffer_length = length;
-					b->length = &length;
-				}
-				else {
-					b->buffer_type = MYSQL_TYPE_NULL;
-				}
+				b->buffer_type = type;
+				b->buffer = buffer;
+				b->buffer_length = length;
+				b->length = &length;
+				b->is_unsigned = is_unsigned;
+				return true;
 			}
 		};
 
@@ -905,19 +1016,20 @@ namespace prep {
 		///
 		virtual void bind(int col,std::istream &v)
 		{
+			param &p = at(col);
 			std::ostringstream ss;
 			ss << v.rdbuf();
-			at(col).set_str(ss.str());
-			at(col).is_blob = true;
+			p.set_str(ss.str(),true);
 		}
 		template<typename T>
 		void do_bind(int col,T v)
 		{
-			fmt_.str(std::string());
 			if(!std::numeric_limits<T>::is_integer)
-				fmt_ << std::setprecision(std::numeric_limits<T>::digits10+1);
-			fmt_ << v;
-			at(col).set_str(fmt_.str());
+				at(col).set(static_cast<double>(v));
+			else if(std::numeric_limits<T>::is_signed)
+				at(col).set(static_cast<long long>(v));
+			else
+				at(col).set(static_cast<unsigned long long>(v));
 		}
 		///
 		/// Bind an integer value to column \a col (starting from 1).
@@ -1026,7 +1138,7 @@ namespace prep {
 		///
 		virtual void bind_null(int col)
 		{
-			at(col)=param();
+			at(col).set_null();
 		}
 		///
 		/// Fetch the last sequence generated for last inserted row. May use sequence as parameter
@@ -1054,10 +1166,19 @@ namespace prep {
 		void bind_all()
 		{
 			if(!params_.empty()) {
-				for(unsigned i=0;i<params_.size();i++)
-					params_[i].bind_it(&bind_[i]);
-				if(mysql_stmt_bind_param(stmt_,&bind_.front())) {
-					throw cppdb_myerror(mysql_stmt_error(stmt_));
+				bool changed = !bound_;
+				for(unsigned i=0;i<params_.size();i++) {
+					if(params_[i].bind_it(&bind_[i]))
+						changed = true;
+				}
+				// client library keeps its own copy of the bindings
+				// so it is only needed when types or buffers change
+				if(changed) {
+					bound_ = false;
+					if(mysql_stmt_bind_param(stmt_,&bind_.front())) {
+						throw cppdb_myerror(mysql_stmt_error(stmt_));
+					}
+					bound_ = true;
 				}
 			}
 		}
@@ -1068,10 +1189,26 @@ namespace prep {
 		virtual result *query() 
 		{
 			bind_all();
+			server_reset_required_ = true;
 			if(mysql_stmt_execute(stmt_)) {
 				throw cppdb_myerror(mysql_stmt_error(stmt_));
 			}
-			return new result(stmt_);
+			result *r;
+			if(!result_) {
+				r = result_ = new result(stmt_);
+				result_->keep_for_reuse(true);
+			}
+			else if(result_->use_count() == 0) {
+				r = result_;
+				r->reuse();
+			}
+			else {
+				// previous result is still referenced
+				r = new result(stmt_);
+			}
+			// all rows are stored at the client side
+			server_reset_required_ = false;
+			return r;
 		}
 		///
 		/// Execute a statement, MAY throw cppdb_error if the statement returns results.
@@ -1079,12 +1216,14 @@ namespace prep {
 		virtual void exec() 
 		{
 			bind_all();
+			server_reset_required_ = true;
 			if(mysql_stmt_execute(stmt_)) {
 				throw cppdb_myerror(mysql_stmt_error(stmt_));
 			}
 			if(mysql_stmt_store_result(stmt_)) {
 				throw cppdb_myerror(mysql_stmt_error(stmt_));
 			}
+			server_reset_required_ = false;
 			MYSQL_RES *r=mysql_stmt_result_metadata(stmt_);
 			if(r) {
 				mysql_free_result(r);
@@ -1098,10 +1237,11 @@ namespace prep {
 		statement(std::string const &q,MYSQL *conn) :
 			query_(q),
 			stmt_(0),
-			params_count_(0)
+			params_count_(0),
+			server_reset_required_(false),
+			bound_(false),
+			result_(0)
 		{
-			fmt_.imbue(std::locale::classic());
-
 			stmt_ = mysql_stmt_init(conn);
 			try {
 				if(!stmt_) {
@@ -1111,7 +1251,8 @@ namespace prep {
 					throw cppdb_myerror(mysql_stmt_error(stmt_));
 				}
 				params_count_ = mysql_stmt_param_count(stmt_);
-				reset_data();
+				params_.resize(params_count_);
+				bind_.resize(params_count_,MYSQL_BIND());
 			}
 			catch(...) {
 				if(stmt_)
@@ -1121,19 +1262,37 @@ namespace prep {
 		}
 		virtual ~statement()
 		{
+			if(result_) {
+				if(result_->use_count() == 0)
+					delete result_;
+				else
+					result_->keep_for_reuse(false);
+			}
 			mysql_stmt_close(stmt_);
 		}
 		void reset_data()
 		{
-			params_.resize(0);
-			params_.resize(params_count_);
-			bind_.resize(0);
-			bind_.resize(params_count_,MYSQL_BIND());
+			// bind_ is kept as is, bind_all() compares against it
+			for(unsigned i=0;i<params_.size();i++)
+				params_[i].set_null();
 		}
+		///
+		/// mysql_stmt_reset() costs a round trip to the server, it is required only if the server
+		/// holds some state of the statement: an open cursor, long data sent with mysql_stmt_send_long_data()
+		/// or unread result. The driver uses neither cursors nor long data and stores all results at
+		/// the client side, so unless the last execution was interrupted by an error, releasing the
+		/// stored result locally is enough.
+		///
 		virtual void reset()
 		{
 			reset_data();
-			mysql_stmt_reset(stmt_);
+			if(server_reset_required_) {
+				mysql_stmt_reset(stmt_);
+				server_reset_required_ = false;
+			}
+			else {
+				mysql_stmt_free_result(stmt_);
+			}
 		}
 
 	private:
@@ -1144,12 +1303,15 @@ namespace prep {
 			return params_[col-1];
 		}
 
-		std::ostringstream fmt_;
 		std::vector<param> params_;
 		std::vector<MYSQL_BIND> bind_;
 		std::string query_;
 		MYSQL_STMT *stmt_;
 		int params_count_;
+		bool server_reset_required_;
+		bool bound_;
+		// kept for reuse by the next query
+		result *result_;
 	};
 
 } // prep
@@ -1160,7 +1322,8 @@ class connection : public backend::connection {
 public:
 	connection(connection_info const &ci) : 
 		backend::connection(ci),
-		conn_(0)
+		conn_(0),
+		local_infile_(false)
 	{
 		conn_ = mysql_init(0);
 		if(!conn_) {
@@ -1207,7 +1370,8 @@ public:
 		#endif
 		if(ci.has("opt_local_infile")) {
 			if(unsigned local_infile = ci.get("opt_local_infile", 0)) {
-				mysql_set_option(MYSQL_OPT_CONNECT_TIMEOUT, &local_infile);
+				mysql_set_option(MYSQL_OPT_LOCAL_INFILE, &local_infile);
+				local_infile_ = true;
 			}
 		}
 		if(ci.has("opt_named_pipe")) {
@@ -1362,6 +1526,47 @@ public:
 		return new unprep::statement(q,conn_);
 	}
 	///
+	/// Use LOAD DATA LOCAL INFILE feeding the rows from \a source via a custom infile handler,
+	/// fall back to multi-row inserts if local infile is not enabled for the connection
+	///
+	virtual unsigned long long bulk_load(std::string const &table,std::vector<std::string> const &columns,bulk_source &source)
+	{
+		if(!local_infile_)
+			return backend::connection::bulk_load(table,columns,source);
+		if(columns.empty())
+			throw cppdb_myerror("bulk_load: no columns given");
+
+		std::string q = "LOAD DATA LOCAL INFILE 'cppdb_bulk' INTO TABLE ";
+		q += table;
+		if(char const *charset = mysql_character_set_name(conn_)) {
+			q += " CHARACTER SET ";
+			q += charset;
+		}
+		q += " FIELDS TERMINATED BY '\\t' ESCAPED BY '\\\\' LINES TERMINATED BY '\\n' (";
+		for(size_t i=0;i<columns.size();i++) {
+			if(i > 0)
+				q += ',';
+			q += columns[i];
+		}
+		q += ')';
+
+		infile_loader loader(source,columns.size());
+		mysql_set_local_infile_handler(conn_,
+			infile_loader::init,
+			infile_loader::read,
+			infile_loader::end,
+			infile_loader::error,
+			&loader);
+		int r = mysql_real_query(conn_,q.c_str(),q.size());
+		mysql_set_local_infile_default(conn_);
+		if(r) {
+			if(loader.failure)
+				std::rethrow_exception(loader.failure);
+			throw cppdb_myerror(mysql_error(conn_));
+		}
+		return mysql_affected_rows(conn_);
+	}
+	///
 	/// Escape a string for inclusion in SQL query. May throw not_supported_by_backend() if not supported by backend.
 	///
 	virtual std::string escape(std::string const &s) 
@@ -1416,8 +1621,139 @@ private:
 			throw cppdb_error("cppdb::mysql failed to set option");
 		}
 	}
+	///
+	/// Converts the rows pulled from bulk_source to LOAD DATA text format one row at a time,
+	/// so the data is produced only as fast as the server consumes it.
+	///
+	struct infile_loader {
+		infile_loader(bulk_source &s,size_t n) :
+			source(s),
+			columns(n),
+			pos(0),
+			done(false)
+		{
+			ss.imbue(std::locale::classic());
+			ss << std::setprecision(std::numeric_limits<double>::digits10+2);
+		}
+
+		bulk_source &source;
+		size_t columns;
+		params row;
+		std::string buffer;
+		size_t pos;
+		bool done;
+		std::ostringstream ss;
+		std::exception_ptr failure;
+		std::string message;
+
+		void add_text(std::string const &v)
+		{
+			for(size_t i=0;i<v.size();i++) {
+				char c = v[i];
+				switch(c) {
+				case '\\': buffer += "\\\\"; break;
+				case '\t': buffer += "\\t"; break;
+				case '\n': buffer += "\\n"; break;
+				case '\r': buffer += "\\r"; break;
+				case '\0': buffer += "\\0"; break;
+				default: buffer += c;
+				}
+			}
+		}
+		bool fetch_row()
+		{
+			row.clear();
+			if(!source.next(row))
+				return false;
+			if(row.size() != columns)
+				throw cppdb_myerror("bulk_load: row size does not match the number of columns");
+			buffer.clear();
+			pos = 0;
+			char tmp[32];
+			for(size_t i=0;i<columns;i++) {
+				if(i > 0)
+					buffer += '\t';
+				switch(row.type(i)) {
+				case params::null_type:
+					buffer += "\\N";
+					break;
+				case params::int_type:
+					snprintf(tmp,sizeof(tmp),"%lld",row.as_int(i));
+					buffer += tmp;
+					break;
+				case params::uint_type:
+					snprintf(tmp,sizeof(tmp),"%llu",row.as_uint(i));
+					buffer += tmp;
+					break;
+				case params::real_type:
+					ss.str(std::string());
+					ss << row.as_real(i);
+					buffer += ss.str();
+					break;
+				case params::text_type:
+					add_text(row.as_text(i));
+					break;
+				case params::time_type:
+					buffer += format_time(row.as_time(i));
+					break;
+				}
+			}
+			buffer += '\n';
+			return true;
+		}
+		int read_some(char *buf,unsigned len)
+		{
+			while(pos == buffer.size()) {
+				if(done || !fetch_row()) {
+					done = true;
+					return 0;
+				}
+			}
+			size_t n = std::min(size_t(len),buffer.size() - pos);
+			memcpy(buf,buffer.c_str() + pos,n);
+			pos += n;
+			return n;
+		}
+
+		static int init(void **ptr,char const * /*filename*/,void *userdata)
+		{
+			*ptr = userdata;
+			return 0;
+		}
+		static int read(void *ptr,char *buf,unsigned len)
+		{
+			infile_loader *self = static_cast<infile_loader *>(ptr);
+			try {
+				return self->read_some(buf,len);
+			}
+			catch(std::exception const &e) {
+				self->message = e.what();
+				self->failure = std::current_exception();
+			}
+			catch(...) {
+				self->message = "bulk_load: unknown error";
+				self->failure = std::current_exception();
+			}
+			return -1;
+		}
+		static void end(void * /*ptr*/)
+		{
+		}
+		static int error(void *ptr,char *msg,unsigned len)
+		{
+			infile_loader *self = static_cast<infile_loader *>(ptr);
+			if(len > 0) {
+				size_t n = std::min(size_t(len - 1),self->message.size());
+				memcpy(msg,self->message.c_str(),n);
+				msg[n] = 0;
+			}
+			return CR_UNKNOWN_ERROR;
+		}
+	};
+
 	connection_info ci_;
 	MYSQL *conn_;
+	bool local_infile_;
 };
 
 
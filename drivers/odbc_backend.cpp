@@ -23,12 +23,15 @@
 #include <cppdb/utils.h>
 #include <cppdb/numeric_util.h>
 #include <list>
+#include <memory>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <limits>
+#include <cmath>
 #include <iomanip>
 #include <string.h>
+#include <ctype.h>
 
 #if defined(_WIN32) || defined(__WIN32) || defined(WIN32) || defined(__CYGWIN__)
 #include <windows.h>
@@ -404,7 +407,35 @@ void check_odbc_error(SQLRETURN error,SQLHANDLE h,SQLSMALLINT type,bool wide)
 
 class result : public backend::result {
 public:
-	typedef std::pair<bool,std::string> cell_type;
+	///
+	/// A value of a single column fetched using the C type that matches its SQL type
+	///
+	struct cell_type {
+		typedef enum {
+			null_cell,
+			int_cell,
+			uint_cell,
+			real_cell,
+			float_cell,	// single precision value kept in number.r
+			time_cell,
+			date_cell,	// time_cell without the time of the day
+			text_cell
+		} kind_type;
+
+		cell_type() : kind(null_cell)
+		{
+			number.i = 0;
+		}
+
+		kind_type kind;
+		union {
+			long long i;
+			unsigned long long u;
+			double r;
+		} number;
+		std::tm time;
+		std::string text;
+	};
 	typedef std::vector<cell_type> row_type;
 	typedef std::list<row_type> rows_type;
 	
@@ -428,12 +459,62 @@ public:
 		return current_!=rows_.end();
 	}
 	template<typename T>
+	static T int_cast(long long v)
+	{
+		T tmp = static_cast<T>(v);
+		if(static_cast<long long>(tmp)!=v || (v < 0 && !std::numeric_limits<T>::is_signed))
+			throw bad_value_cast();
+		return tmp;
+	}
+	template<typename T>
+	static T int_cast(unsigned long long v)
+	{
+		T tmp = static_cast<T>(v);
+		if(static_cast<unsigned long long>(tmp)!=v || tmp < 0)
+			throw bad_value_cast();
+		return tmp;
+	}
+	template<typename T>
+	static T real_cast(double v)
+	{
+		if(std::numeric_limits<T>::is_integer) {
+			// max() may round up to 2^digits as double which is out of range, so the upper bound
+			// is exclusive; written so NaN fails as well
+			double const upper = std::ldexp(1.0,std::numeric_limits<T>::digits);
+			if(!(v >= double(std::numeric_limits<T>::min()) && v < upper))
+				throw bad_value_cast();
+		}
+		return static_cast<T>(v);
+	}
+	template<typename T>
 	bool do_fetch(int col,T &v)
 	{
-		if(at(col).first)
+		cell_type &c = at(col);
+		switch(c.kind) {
+		case cell_type::null_cell:
 			return false;
-		v=parse_number<T>(at(col).second,ss_);
-		return true;
+		case cell_type::int_cell:
+			if(std::numeric_limits<T>::is_integer)
+				v = int_cast<T>(c.number.i);
+			else
+				v = static_cast<T>(c.number.i);
+			return true;
+		case cell_type::uint_cell:
+			if(std::numeric_limits<T>::is_integer)
+				v = int_cast<T>(c.number.u);
+			else
+				v = static_cast<T>(c.number.u);
+			return true;
+		case cell_type::real_cell:
+		case cell_type::float_cell:
+			v = real_cast<T>(c.number.r);
+			return true;
+		case cell_type::text_cell:
+			v=parse_number<T>(c.text,ss_);
+			return true;
+		default:
+			throw bad_value_cast();
+		}
 	}
 	virtual bool fetch(int col,short &v)
 	{
@@ -481,28 +562,95 @@ public:
 	}
 	virtual bool fetch(int col,std::string &v)
 	{
-		if(at(col).first)
+		cell_type &c = at(col);
+		switch(c.kind) {
+		case cell_type::null_cell:
 			return false;
-		v=at(col).second;
-		return true;
+		case cell_type::text_cell:
+			v = c.text;
+			return true;
+		case cell_type::time_cell:
+			v = format_time(c.time);
+			return true;
+		case cell_type::date_cell:
+			{
+				char buf[32];
+				strftime(buf,sizeof(buf),"%Y-%m-%d",&c.time);
+				v = buf;
+			}
+			return true;
+		case cell_type::real_cell:
+			v = format_real<double>(c.number.r);
+			return true;
+		case cell_type::float_cell:
+			v = format_real<float>(static_cast<float>(c.number.r));
+			return true;
+		default:
+			{
+				std::ostringstream ss;
+				ss.imbue(std::locale::classic());
+				if(c.kind == cell_type::int_cell)
+					ss << c.number.i;
+				else
+					ss << c.number.u;
+				v = ss.str();
+			}
+			return true;
+		}
+	}
+	// the shortest text that is read back as the same value, as the drivers format it
+	template<typename T>
+	static std::string format_real(T v)
+	{
+		for(int digits = std::numeric_limits<T>::digits10;;digits = std::numeric_limits<T>::max_digits10) {
+			std::ostringstream ss;
+			ss.imbue(std::locale::classic());
+			ss << std::setprecision(digits) << v;
+			if(digits == std::numeric_limits<T>::max_digits10)
+				return ss.str();
+			std::istringstream in(ss.str());
+			in.imbue(std::locale::classic());
+			T back = 0;
+			in >> back;
+			if(back == v)
+				return ss.str();
+		}
 	}
 	virtual bool fetch(int col,std::ostream &v) 
 	{
-		if(at(col).first)
+		cell_type &c = at(col);
+		if(c.kind == cell_type::text_cell) {
+			v << c.text;
+			return true;
+		}
+		std::string tmp;
+		if(!fetch(col,tmp))
 			return false;
-		v << at(col).second;
+		v << tmp;
 		return true;
 	}
 	virtual bool fetch(int col,std::tm &v)
 	{
-		if(at(col).first)
+		cell_type &c = at(col);
+		switch(c.kind) {
+		case cell_type::null_cell:
 			return false;
-		v = parse_time(at(col).second);
-		return true;
+		case cell_type::time_cell:
+		case cell_type::date_cell:
+			v = c.time;
+			if(mktime(&v)==-1)
+				throw bad_value_cast();
+			return true;
+		case cell_type::text_cell:
+			v = parse_time(c.text);
+			return true;
+		default:
+			throw bad_value_cast();
+		}
 	}
 	virtual bool is_null(int col)
 	{
-		return at(col).first;
+		return at(col).kind == cell_type::null_cell;
 	}
 	virtual int cols()
 	{
@@ -550,12 +698,53 @@ class statements_cache;
 class connection;
 
 class statement : public backend::statement {
+	///
+	/// A parameter keeps its value in its own storage, so once it is bound with SQLBindParameter
+	/// the binding stays valid for following executions and only has to be repeated
+	/// when the type, the size or the location of the value changes.
+	///
 	struct parameter {
 		parameter() : 
 			null(true),
 			ctype(SQL_C_CHAR),
-			sqltype(SQL_C_NUMERIC)
+			sqltype(SQL_NUMERIC),
+			column_size(10),
+			lenval(SQL_NULL_DATA),
+			bound(false)
 		{
+			number.i = 0;
+		}
+		parameter(parameter const &other) :
+			value(other.value),
+			null(other.null),
+			ctype(other.ctype),
+			sqltype(other.sqltype),
+			column_size(other.column_size),
+			number(other.number),
+			time(other.time),
+			lenval(other.lenval),
+			bound(false)
+		{
+		}
+		parameter const &operator=(parameter const &other)
+		{
+			value = other.value;
+			null = other.null;
+			ctype = other.ctype;
+			sqltype = other.sqltype;
+			column_size = other.column_size;
+			number = other.number;
+			time = other.time;
+			lenval = other.lenval;
+			bound = false;
+			return *this;
+		}
+		void set_null()
+		{
+			null = true;
+			ctype = SQL_C_CHAR;
+			sqltype = SQL_NUMERIC;
+			column_size = 10;
 		}
 		void set_binary(char const *b,char const *e)
 		{
@@ -563,6 +752,7 @@ class statement : public backend::statement {
 			null=false;
 			ctype=SQL_C_BINARY;
 			sqltype = SQL_LONGVARBINARY;
+			column_size = value.size();
 		}
 		void set_text(char const *b,char const *e,bool wide)
 		{
@@ -571,6 +761,7 @@ class statement : public backend::statement {
 				null=false;
 				ctype=SQL_C_CHAR;
 				sqltype = SQL_LONGVARCHAR;
+				column_size = value.size();
 			}
 			else {
 				std::string tmp = widen(b,e);
@@ -578,76 +769,133 @@ class statement : public backend::statement {
 				null=false;
 				ctype=SQL_C_WCHAR;
 				sqltype = SQL_WLONGVARCHAR;
+				column_size = value.size() / 2;
 			}
 		}
 		void set(std::tm const &v)
 		{
-			value = cppdb::format_time(v);
+			time.year = v.tm_year + 1900;
+			time.month = v.tm_mon + 1;
+			time.day = v.tm_mday;
+			time.hour = v.tm_hour;
+			time.minute = v.tm_min;
+			time.second = v.tm_sec;
+			time.fraction = 0;
 			null=false;
-			sqltype = SQL_C_TIMESTAMP;
-			ctype = SQL_C_CHAR;
+			ctype = SQL_C_TYPE_TIMESTAMP;
+			sqltype = SQL_TYPE_TIMESTAMP;
+			column_size = 19;
 		}
 
 		template<typename T>
 		void set(T v)
 		{
-			std::ostringstream ss;
-			ss.imbue(std::locale::classic());
-			if(!std::numeric_limits<T>::is_integer)
-				ss << std::setprecision(std::numeric_limits<T>::digits10+1);
-			ss << v;
-
-			value=ss.str();
 			null=false;
-			ctype = SQL_C_CHAR;
-			if(std::numeric_limits<T>::is_integer) 
-				sqltype = SQL_INTEGER;
-			else
+			if(!std::numeric_limits<T>::is_integer) {
+				number.r = static_cast<SQLDOUBLE>(v);
+				ctype = SQL_C_DOUBLE;
 				sqltype = SQL_DOUBLE;
-
+				column_size = 15;
+			}
+			else if(std::numeric_limits<T>::is_signed) {
+				number.i = static_cast<SQLBIGINT>(v);
+				ctype = SQL_C_SBIGINT;
+				sqltype = sizeof(T) <= 4 ? SQL_INTEGER : SQL_BIGINT;
+				column_size = sizeof(T) <= 4 ? 10 : 19;
+			}
+			else {
+				number.u = static_cast<SQLUBIGINT>(v);
+				ctype = SQL_C_UBIGINT;
+				sqltype = sizeof(T) < 4 ? SQL_INTEGER : SQL_BIGINT;
+				column_size = sizeof(T) < 4 ? 10 : 20;
+			}
+		}
+		void *buffer()
+		{
+			if(null)
+				return 0;
+			switch(ctype) {
+			case SQL_C_SBIGINT:
+			case SQL_C_UBIGINT:
+			case SQL_C_DOUBLE:
+				return &number;
+			case SQL_C_TYPE_TIMESTAMP:
+				return &time;
+			default:
+				return (void*)value.c_str();
+			}
+		}
+		SQLLEN buffer_size()
+		{
+			if(null)
+				return 0;
+			switch(ctype) {
+			case SQL_C_SBIGINT:
+			case SQL_C_UBIGINT:
+			case SQL_C_DOUBLE:
+				return sizeof(number);
+			case SQL_C_TYPE_TIMESTAMP:
+				return sizeof(time);
+			default:
+				return value.size();
+			}
 		}
 		void bind(int col,SQLHSTMT stmt,bool wide)
 		{
-			int r;
-			if(null) {
-				lenval = SQL_NULL_DATA;
-				r = SQLBindParameter(	stmt,
-							col,
-							SQL_PARAM_INPUT,
-							SQL_C_CHAR, 
-							SQL_NUMERIC, // for null
-							10, // COLUMNSIZE
-							0, //  Presision
-							0, // string
-							0, // size
-							&lenval);
+			void *ptr = buffer();
+			SQLLEN size = buffer_size();
+			SQLULEN csize = column_size == 0 ? 1 : column_size;
+			lenval = null ? SQL_NULL_DATA : size;
+
+			if(	bound 
+				&& bound_ctype == ctype 
+				&& bound_sqltype == sqltype 
+				&& bound_column_size == csize
+				&& bound_ptr == ptr
+				&& bound_self == this)
+			{
+				return;
 			}
-            else {
-                lenval=value.size();
-                size_t column_size = value.size();
-                if(ctype == SQL_C_WCHAR)
-                    column_size/=2;
-                if(value.empty())
-                    column_size=1;
-                r = SQLBindParameter(	stmt,
-                            col,
-                            SQL_PARAM_INPUT,
-                            ctype,
-                            sqltype,
-                            column_size, // COLUMNSIZE
-                            0, //  Presision
-                            (void*)value.c_str(), // string
-                            value.size(),
-                            &lenval);
-            }
+
+			bound = false;
+			int r = SQLBindParameter(	stmt,
+						col,
+						SQL_PARAM_INPUT,
+						ctype,
+						sqltype,
+						csize, // COLUMNSIZE
+						0, //  Presision
+						ptr,
+						size,
+						&lenval);
 			check_odbc_error(r,stmt,SQL_HANDLE_STMT,wide);
+			bound = true;
+			bound_ctype = ctype;
+			bound_sqltype = sqltype;
+			bound_column_size = csize;
+			bound_ptr = ptr;
+			bound_self = this;
 		}
 
 		std::string value;
 		bool null;
 		SQLSMALLINT ctype;
 		SQLSMALLINT sqltype;
+		SQLULEN column_size;
+		union {
+			SQLBIGINT i;
+			SQLUBIGINT u;
+			SQLDOUBLE r;
+		} number;
+		SQL_TIMESTAMP_STRUCT time;
 		SQLLEN lenval;
+
+		bool bound;
+		SQLSMALLINT bound_ctype;
+		SQLSMALLINT bound_sqltype;
+		SQLULEN bound_column_size;
+		void *bound_ptr;
+		parameter *bound_self;
 	};
 public:
 	// Begin of API
@@ -655,10 +903,15 @@ public:
 	{
 		SQLFreeStmt(stmt_,SQL_UNBIND);
 		SQLCloseCursor(stmt_);
-		params_.resize(0);
-		if(params_no_ > 0)
-			params_.resize(params_no_);
-
+		if(params_no_ >= 0) {
+			// keep the bindings, the buffers stay where they are
+			for(unsigned i=0;i<params_.size();i++)
+				params_[i].set_null();
+		}
+		else {
+			SQLFreeStmt(stmt_,SQL_RESET_PARAMS);
+			params_.resize(0);
+		}
 	}
 	parameter &param_at(int col)
 	{
@@ -740,7 +993,7 @@ public:
 	}
 	virtual void bind_null(int col)
 	{
-		param_at(col) = parameter();
+		param_at(col).set_null();
 	}
 	void bind_all()
 	{
@@ -749,31 +1002,7 @@ public:
 		}
 
 	}
-	virtual long long sequence_last(std::string const &sequence) 
-	{
-		ref_ptr<statement> st;
-		if(!sequence_last_.empty()) {
-			st = new statement(sequence_last_,dbc_,wide_,false);
-			st->bind(1,sequence);
-		}
-		else if(!last_insert_id_.empty()) {
-			st = new statement(last_insert_id_,dbc_,wide_,false);
-		}
-		else {
-			throw not_supported_by_backend(
-				"cppdb::odbc::sequence_last is not supported by odbc backend "
-				"unless properties @squence_last, @last_insert_id are specified "
-				"or @engine is one of mysql, sqlite3, postgresql, mssql");
-		}
-		ref_ptr<result> res = st->query();
-		long long last_id;
-		if(!res->next() || res->cols()!=1 || !res->fetch(0,last_id)) {
-			throw cppdb_error("cppdb::odbc::sequence_last failed to fetch last value");
-		}
-		res.reset();
-		st.reset();
-		return last_id;
-	}
+	virtual long long sequence_last(std::string const &sequence);
 	virtual unsigned long long affected() 
 	{
 		SQLLEN rows = 0;
@@ -789,8 +1018,6 @@ public:
 		result::rows_type rows;
 		result::row_type row;
 		
-		std::string value;
-		bool is_null = false;
 		SQLSMALLINT ocols;
 		r = SQLNumResultCols(stmt_,&ocols);
 		check_error(r);
@@ -815,97 +1042,13 @@ public:
 				check_error(r);
 				names[col]=(char*)name;
 			}
-			switch(data_type) {
-			case SQL_CHAR:
-			case SQL_VARCHAR:
-			case SQL_LONGVARCHAR:
-				types[col]=SQL_C_CHAR;
-				break;
-			case SQL_WCHAR:
-			case SQL_WVARCHAR:
-			case SQL_WLONGVARCHAR:
-				types[col]=SQL_C_WCHAR ;
-				break;
-			case SQL_BINARY:
-			case SQL_VARBINARY:
-			case SQL_LONGVARBINARY:
-				types[col]=SQL_C_BINARY ;
-				break;
-			default:
-				types[col]=SQL_C_DEFAULT;
-				// Just a hack, actually I'm going to use C
-				;
-			}
+			types[col] = column_ctype(col,data_type,collen,digits);
 		}
 
 		while((r=SQLFetch(stmt_))==SQL_SUCCESS || r==SQL_SUCCESS_WITH_INFO) {
 			row.resize(cols);
 			for(int col=0;col < cols;col++) {
-				SQLLEN len = 0;
-				is_null=false;
-				int type = types[col];
-				if(type==SQL_C_DEFAULT) {
-					char buf[64];
-					int r = SQLGetData(stmt_,col+1,SQL_C_CHAR,buf,sizeof(buf),&len);
-					check_error(r);
-					if(len == SQL_NULL_DATA) {
-						is_null = true;
-					}
-					else if(len <= 64) {
-						value.assign(buf,len);
-					}
-					else {
-						throw cppdb_error("cppdb::odbc::query - data too long");
-					}
-				}
-				else {
-					char buf[1024];
-					size_t real_len;
-					if(type == SQL_C_CHAR) {
-						real_len = sizeof(buf)-1;
-					}
-					else if(type == SQL_C_BINARY) {
-						real_len = sizeof(buf);
-					}
-					else { // SQL_C_WCHAR
-						real_len = sizeof(buf) - sizeof(SQLWCHAR);
-					}
-
-					r = SQLGetData(stmt_,col+1,type,buf,sizeof(buf),&len);
-					check_error(r);
-					if(len == SQL_NULL_DATA) {
-						is_null = true;	
-					}
-					else if(len == SQL_NO_TOTAL) {
-						while(len==SQL_NO_TOTAL) {
-							value.append(buf,real_len);
-							r = SQLGetData(stmt_,col+1,type,buf,sizeof(buf),&len);
-							check_error(r);
-						}
-						value.append(buf,len);
-					}
-					else if(0<= len && size_t(len) <= real_len) {
-						value.assign(buf,len);
-					}
-					else if(len>=0) {
-						value.assign(buf,real_len);
-						size_t rem_len = len - real_len;
-						std::vector<char> tmp(rem_len+2,0);
-						r = SQLGetData(stmt_,col+1,type,&tmp[0],tmp.size(),&len);
-						check_error(r);
-						value.append(&tmp[0],rem_len);
-					}
-					else {
-						throw cppdb_error("cppdb::odbc::query invalid result length");
-					}
-					if(!is_null && type == SQL_C_WCHAR) {
-						std::string tmp=narrower(value);
-						value.swap(tmp);
-					}
-				}
-					
-				row[col].first = is_null;
-				row[col].second.swap(value);
+				fetch_cell(col,types[col],row[col]);
 			}
 			rows.push_back(result::row_type());
 			rows.back().swap(row);
@@ -916,6 +1059,189 @@ public:
 		return new result(rows,names,cols);
 	}
 
+	///
+	/// Select the C type a column is fetched with according to its SQL type
+	///
+	int column_ctype(int col,SQLSMALLINT data_type,SQLULEN collen,SQLSMALLINT digits)
+	{
+		switch(data_type) {
+		case SQL_CHAR:
+		case SQL_VARCHAR:
+		case SQL_LONGVARCHAR:
+			return SQL_C_CHAR;
+		case SQL_WCHAR:
+		case SQL_WVARCHAR:
+		case SQL_WLONGVARCHAR:
+			return SQL_C_WCHAR;
+		case SQL_BINARY:
+		case SQL_VARBINARY:
+		case SQL_LONGVARBINARY:
+			return SQL_C_BINARY;
+		case SQL_BIT:
+		case SQL_TINYINT:
+		case SQL_SMALLINT:
+		case SQL_INTEGER:
+			return SQL_C_SBIGINT;
+		case SQL_BIGINT:
+			{
+				SQLLEN is_unsigned = SQL_FALSE;
+				int r = SQLColAttribute(stmt_,col+1,SQL_DESC_UNSIGNED,0,0,0,&is_unsigned);
+				check_error(r);
+				return is_unsigned == SQL_TRUE ? SQL_C_UBIGINT : SQL_C_SBIGINT;
+			}
+		case SQL_NUMERIC:
+		case SQL_DECIMAL:
+			// exact values that do not fit a 64 bit integer keep their precision as text
+			if(digits == 0 && collen <= 18)
+				return SQL_C_SBIGINT;
+			return SQL_C_CHAR;
+		case SQL_REAL:
+			return SQL_C_FLOAT;
+		case SQL_FLOAT:
+		case SQL_DOUBLE:
+			return SQL_C_DOUBLE;
+		case SQL_TYPE_DATE:
+			return SQL_C_TYPE_DATE;
+		case SQL_TYPE_TIMESTAMP:
+			return SQL_C_TYPE_TIMESTAMP;
+		default:
+			return SQL_C_CHAR;
+		}
+	}
+
+	void fetch_cell(int col,int type,result::cell_type &cell)
+	{
+		SQLLEN len = 0;
+		int r;
+		cell.kind = result::cell_type::null_cell;
+		switch(type) {
+		case SQL_C_SBIGINT:
+			{
+				SQLBIGINT v = 0;
+				r = SQLGetData(stmt_,col+1,SQL_C_SBIGINT,&v,sizeof(v),&len);
+				check_error(r);
+				if(len == SQL_NULL_DATA)
+					return;
+				cell.number.i = v;
+				cell.kind = result::cell_type::int_cell;
+			}
+			return;
+		case SQL_C_UBIGINT:
+			{
+				SQLUBIGINT v = 0;
+				r = SQLGetData(stmt_,col+1,SQL_C_UBIGINT,&v,sizeof(v),&len);
+				check_error(r);
+				if(len == SQL_NULL_DATA)
+					return;
+				cell.number.u = v;
+				cell.kind = result::cell_type::uint_cell;
+			}
+			return;
+		case SQL_C_DOUBLE:
+			{
+				SQLDOUBLE v = 0;
+				r = SQLGetData(stmt_,col+1,SQL_C_DOUBLE,&v,sizeof(v),&len);
+				check_error(r);
+				if(len == SQL_NULL_DATA)
+					return;
+				cell.number.r = v;
+				cell.kind = result::cell_type::real_cell;
+			}
+			return;
+		case SQL_C_FLOAT:
+			{
+				SQLREAL v = 0;
+				r = SQLGetData(stmt_,col+1,SQL_C_FLOAT,&v,sizeof(v),&len);
+				check_error(r);
+				if(len == SQL_NULL_DATA)
+					return;
+				cell.number.r = v;
+				cell.kind = result::cell_type::float_cell;
+			}
+			return;
+		case SQL_C_TYPE_DATE:
+			{
+				SQL_DATE_STRUCT v = SQL_DATE_STRUCT();
+				r = SQLGetData(stmt_,col+1,SQL_C_TYPE_DATE,&v,sizeof(v),&len);
+				check_error(r);
+				if(len == SQL_NULL_DATA)
+					return;
+				cell.time = std::tm();
+				cell.time.tm_year = v.year - 1900;
+				cell.time.tm_mon = v.month - 1;
+				cell.time.tm_mday = v.day;
+				cell.time.tm_isdst = -1;
+				cell.kind = result::cell_type::date_cell;
+			}
+			return;
+		case SQL_C_TYPE_TIMESTAMP:
+			{
+				SQL_TIMESTAMP_STRUCT v = SQL_TIMESTAMP_STRUCT();
+				r = SQLGetData(stmt_,col+1,SQL_C_TYPE_TIMESTAMP,&v,sizeof(v),&len);
+				check_error(r);
+				if(len == SQL_NULL_DATA)
+					return;
+				cell.time = std::tm();
+				cell.time.tm_year = v.year - 1900;
+				cell.time.tm_mon = v.month - 1;
+				cell.time.tm_mday = v.day;
+				cell.time.tm_hour = v.hour;
+				cell.time.tm_min = v.minute;
+				cell.time.tm_sec = v.second;
+				cell.time.tm_isdst = -1;
+				cell.kind = result::cell_type::time_cell;
+			}
+			return;
+		}
+
+		std::string &value = cell.text;
+		value.clear();
+		char buf[1024];
+		size_t real_len;
+		if(type == SQL_C_CHAR) {
+			real_len = sizeof(buf)-1;
+		}
+		else if(type == SQL_C_BINARY) {
+			real_len = sizeof(buf);
+		}
+		else { // SQL_C_WCHAR
+			real_len = sizeof(buf) - sizeof(SQLWCHAR);
+		}
+
+		r = SQLGetData(stmt_,col+1,type,buf,sizeof(buf),&len);
+		check_error(r);
+		if(len == SQL_NULL_DATA) {
+			return;
+		}
+		else if(len == SQL_NO_TOTAL) {
+			while(len==SQL_NO_TOTAL) {
+				value.append(buf,real_len);
+				r = SQLGetData(stmt_,col+1,type,buf,sizeof(buf),&len);
+				check_error(r);
+			}
+			value.append(buf,len);
+		}
+		else if(0<= len && size_t(len) <= real_len) {
+			value.assign(buf,len);
+		}
+		else if(len>=0) {
+			value.assign(buf,real_len);
+			size_t rem_len = len - real_len;
+			std::vector<char> tmp(rem_len+2,0);
+			r = SQLGetData(stmt_,col+1,type,&tmp[0],tmp.size(),&len);
+			check_error(r);
+			value.append(&tmp[0],rem_len);
+		}
+		else {
+			throw cppdb_error("cppdb::odbc::query invalid result length");
+		}
+		if(type == SQL_C_WCHAR) {
+			std::string tmp=narrower(value);
+			value.swap(tmp);
+		}
+		cell.kind = result::cell_type::text_cell;
+	}
+
 	int real_exec()
 	{
 		int r = 0;
@@ -939,7 +1265,8 @@ public:
 	}
 	// End of API
 
-	statement(std::string const &q,SQLHDBC dbc,bool wide,bool prepared) :
+	statement(std::string const &q,SQLHDBC dbc,bool wide,bool prepared,connection *conn) :
+		conn_(conn),
 		dbc_(dbc),
 		wide_(wide),
 		query_(q),
@@ -989,16 +1316,13 @@ private:
 	}
 
 
+	connection *conn_;
 	SQLHDBC dbc_;
 	SQLHSTMT stmt_;
 	bool wide_;
 	std::string query_;
 	std::vector<parameter> params_;
 	int params_no_;
-
-	friend class connection;
-	std::string sequence_last_;
-	std::string last_insert_id_;
 	bool prepared_;
 
 };
@@ -1055,6 +1379,25 @@ public:
 				SQLFreeHandle(SQL_HANDLE_ENV,env_);
 			throw;
 		}
+
+		std::string seq = ci.get("@sequence_last","");
+		if(seq.empty()) {
+			std::string eng=engine();
+			if(eng == "sqlite3")
+				last_insert_id_ = "select last_insert_rowid()";
+			else if(eng == "mysql")
+				last_insert_id_ = "select last_insert_id()";
+			else if(eng == "postgresql")
+				sequence_last_ = "select currval(?)";
+			else if(eng == "mssql")
+				last_insert_id_ = "select @@identity";
+		}
+		else {
+			if(seq.find('?')==std::string::npos)
+				last_insert_id_ = seq;
+			else
+				sequence_last_ = seq;
+		}
 	}
 
 	std::string conn_str(connection_info const &ci)
@@ -1074,6 +1417,7 @@ public:
 	
 	~connection()
 	{
+		last_id_stmt_.reset();
 		SQLDisconnect(dbc_);
 		SQLFreeHandle(SQL_HANDLE_DBC,dbc_);
 		SQLFreeHandle(SQL_HANDLE_ENV,env_);
@@ -1103,27 +1447,50 @@ public:
 	}
 	statement *real_prepare(std::string const &q,bool prepared)
 	{
-		std::unique_ptr<statement> st(new statement(q,dbc_,wide_,prepared));
-		std::string seq = ci_.get("@sequence_last","");
-		if(seq.empty()) {
-			std::string eng=engine();
-			if(eng == "sqlite3")
-				st->last_insert_id_ = "select last_insert_rowid()";
-			else if(eng == "mysql")
-				st->last_insert_id_ = "select last_insert_id()";
-			else if(eng == "postgresql")
-				st->sequence_last_ = "select currval(?)";
-			else if(eng == "mssql")
-				st->last_insert_id_ = "select @@identity";
+		return new statement(q,dbc_,wide_,prepared,this);
+	}
+
+	///
+	/// Fetch the last generated id, the helper statement is prepared once per connection
+	///
+	long long sequence_last(std::string const &sequence)
+	{
+		if(!last_id_stmt_) {
+			if(!sequence_last_.empty()) {
+				last_id_stmt_.reset(new statement(sequence_last_,dbc_,wide_,true,this));
+			}
+			else if(!last_insert_id_.empty()) {
+				last_id_stmt_.reset(new statement(last_insert_id_,dbc_,wide_,true,this));
+			}
+			else {
+				throw not_supported_by_backend(
+					"cppdb::odbc::sequence_last is not supported by odbc backend "
+					"unless properties @squence_last, @last_insert_id are specified "
+					"or @engine is one of mysql, sqlite3, postgresql, mssql");
+			}
 		}
-		else {
-			if(seq.find('?')==std::string::npos)
-				st->last_insert_id_ = seq;
-			else
-				st->sequence_last_ = seq;
+		statement &st = *last_id_stmt_;
+		st.reset();
+		if(!sequence_last_.empty())
+			st.bind(1,sequence);
+		ref_ptr<result> res = st.query();
+		long long last_id;
+		if(!res->next() || res->cols()!=1 || !res->fetch(0,last_id)) {
+			throw cppdb_error("cppdb::odbc::sequence_last failed to fetch last value");
 		}
+		res.reset();
+		st.reset();
+		return last_id;
+	}
 
-		return st.release();		
+	virtual std::string returning_query(std::string const &q,std::string const &column)
+	{
+		std::string eng = engine();
+		if(eng == "postgresql")
+			return q + " RETURNING " + column;
+		if(eng == "mssql")
+			return output_inserted_query(q,column);
+		return std::string();
 	}
 
 	virtual statement *prepare_statement(std::string const &q)
@@ -1170,12 +1537,62 @@ public:
 	}
 
 private:
+	///
+	/// Put OUTPUT INSERTED.column clause before VALUES, SELECT or DEFAULT VALUES part
+	/// of the INSERT statement \a q, returns empty string if not found.
+	///
+	static std::string output_inserted_query(std::string const &q,std::string const &column)
+	{
+		static char const *keywords[] = { "values", "select", "default" };
+		int depth = 0;
+		char quote = 0;
+		for(size_t i=0;i<q.size();i++) {
+			char c = q[i];
+			if(quote) {
+				if(c == quote)
+					quote = 0;
+				continue;
+			}
+			switch(c) {
+			case '\'': quote = '\''; continue;
+			case '"': quote = '"'; continue;
+			case '[': quote = ']'; continue;
+			case '(': depth++; continue;
+			case ')': depth--; continue;
+			}
+			if(depth != 0 || (i > 0 && (isalnum((unsigned char)(q[i-1])) || q[i-1]=='_')))
+				continue;
+			for(unsigned k=0;k<sizeof(keywords)/sizeof(keywords[0]);k++) {
+				size_t len = strlen(keywords[k]);
+				if(i + len > q.size())
+					continue;
+				bool match = true;
+				for(size_t j=0;j<len && match;j++)
+					match = tolower((unsigned char)(q[i+j])) == keywords[k][j];
+				if(!match)
+					continue;
+				if(i + len < q.size() && (isalnum((unsigned char)(q[i+len])) || q[i+len]=='_'))
+					continue;
+				return q.substr(0,i) + "OUTPUT INSERTED." + column + " " + q.substr(i);
+			}
+		}
+		return std::string();
+	}
+
 	SQLHENV env_;
 	SQLHDBC dbc_;
 	bool wide_;
 	connection_info ci_;
+	std::string sequence_last_;
+	std::string last_insert_id_;
+	std::unique_ptr<statement> last_id_stmt_;
 };
 
+long long statement::sequence_last(std::string const &sequence)
+{
+	return conn_->sequence_last(sequence);
+}
+
 
 } // odbc_backend
 } // cppdb
@@ -86,6 +86,15 @@ namespace cppdb {
 			{
 				PQclear(res_);
 			}
+			// prepare the object kept by the statement for the next query
+			void reuse(PGresult *res)
+			{
+				PQclear(res_);
+				res_ = res;
+				rows_ = PQntuples(res);
+				cols_ = PQnfields(res);
+				current_ = -1;
+			}
 			virtual next_row has_next()
 			{
 				if(current_ + 1 < rows_)
@@ -272,12 +281,14 @@ namespace cppdb {
 				binary_param
 			} param_type;
 
-			statement(PGconn *conn,std::string const &src_query,blob_type b,unsigned long long prepared_id) :
+			statement(PGconn *conn,std::string const &src_query,blob_type b,unsigned long long prepared_id,bool send_prepare = true) :
 				res_(0),
 				conn_(conn),
 				orig_query_(src_query),
 				params_(0),
-				blob_(b)
+				blob_(b),
+				async_pending_(false),
+				result_(0)
 			{
 				fmt_.imbue(std::locale::classic());
 
@@ -311,6 +322,10 @@ namespace cppdb {
 					fmt_.str(std::string());
 					fmt_.clear();
 
+					// preparation is sent by the caller, see connection::prepare_statements
+					if(!send_prepare)
+						return;
+
 					PGresult *r=PQprepare(conn_,prepared_id_.c_str(),query_.c_str(),0,0);
 					try {
 						if(!r) {
@@ -328,7 +343,14 @@ namespace cppdb {
 			}
 			virtual ~statement()
 			{
+				if(result_) {
+					if(result_->use_count() == 0)
+						delete result_;
+					else
+						result_->keep_for_reuse(false);
+				}
 				try {
+					discard_async();
 					if(res_) {
 						PQclear(res_);
 						res_ = 0;
@@ -348,18 +370,18 @@ namespace cppdb {
 			}
 			virtual void reset()
 			{
+				discard_async();
 				if(res_) {
 					PQclear(res_);
 					res_ = 0;
 				}
-				std::vector<std::string> vals(params_);
-				std::vector<size_t> lengths(params_,0);
-				std::vector<char const *> pvals(params_,0);
-				std::vector<param_type> flags(params_,null_param);
-				params_values_.swap(vals);
-				params_pvalues_.swap(pvals);
-				params_plengths_.swap(lengths);
-				params_set_.swap(flags);
+				// keep the storage for the next execution
+				params_values_.resize(params_);
+				for(unsigned i=0;i<params_;i++)
+					params_values_[i].clear();
+				params_pvalues_.assign(params_,0);
+				params_plengths_.assign(params_,0);
+				params_set_.assign(params_,null_param);
 			}
 			virtual void bind(int col,std::string const &v)
 			{
@@ -485,18 +507,57 @@ namespace cppdb {
 				params_values_[col-1].swap(tmp);
 			}
 
-			void real_query()
+			virtual bool send_async()
+			{
+				discard_async();
+				real_query(true);
+				async_pending_ = true;
+				return true;
+			}
+			virtual bool async_ready()
 			{
+				if(!async_pending_)
+					return true;
+				if(!PQconsumeInput(conn_))
+					return true; // the error is reported by collect_async()
+				return !PQisBusy(conn_);
+			}
+			virtual int async_socket()
+			{
+				return PQsocket(conn_);
+			}
+			// collect the result of either a query or a statement sent with send_async()
+			backend::result *collect(unsigned long long &affected)
+			{
+				real_query();
+				switch(PQresultStatus(res_)){
+				case PGRES_TUPLES_OK:
+					affected = 0;
+					return make_result();
+				case PGRES_COMMAND_OK:
+					affected = this->affected();
+					return 0;
+				default:
+					throw pqerror(res_,"query execution failed ");
+				}
+			}
+
+			void real_query(bool send = false)
+			{
+				if(async_pending_) {
+					collect_async();
+					return;
+				}
 				char const * const *pvalues = 0;
 				int *plengths = 0;
 				int *pformats = 0;
-				std::vector<char const *> values;
-				std::vector<int> lengths;
-				std::vector<int> formats;
 				if(params_>0) {
-					values.resize(params_,0);
-					lengths.resize(params_,0);
-					formats.resize(params_,0);
+					std::vector<char const *> &values = query_values_;
+					std::vector<int> &lengths = query_lengths_;
+					std::vector<int> &formats = query_formats_;
+					values.assign(params_,0);
+					lengths.assign(params_,0);
+					formats.assign(params_,0);
 					for(unsigned i=0;i<params_;i++) {
 						if(params_set_[i]!=null_param) {
 							if(params_pvalues_[i]!=0) {
@@ -520,7 +581,16 @@ namespace cppdb {
 					PQclear(res_);
 					res_ = 0;
 				}
-				if(prepared_id_.empty()) {
+				if(send) {
+					int ok;
+					if(prepared_id_.empty())
+						ok = PQsendQueryParams(conn_,query_.c_str(),params_,0,pvalues,plengths,pformats,0);
+					else
+						ok = PQsendQueryPrepared(conn_,prepared_id_.c_str(),params_,pvalues,plengths,pformats,0);
+					if(!ok)
+						throw pqerror(conn_,"failed to send query");
+				}
+				else if(prepared_id_.empty()) {
 					res_ = PQexecParams(
 						conn_,
 						query_.c_str(),
@@ -550,12 +620,7 @@ namespace cppdb {
 				real_query();
 				switch(PQresultStatus(res_)){
 				case PGRES_TUPLES_OK:
-					{
-						result *ptr = new result(res_,conn_,blob_);
-						res_ = 0;
-						return ptr;
-					}
-					break;
+					return make_result();
 				case PGRES_COMMAND_OK:
 					throw pqerror("Statement used instread of query");
 					break;
@@ -631,12 +696,64 @@ namespace cppdb {
 			{
 				return orig_query_;
 			}
+			std::string const &prepared_name() const
+			{
+				return prepared_id_;
+			}
+			std::string const &native_query() const
+			{
+				return query_;
+			}
+			// the statement was never prepared on the server, nothing to deallocate
+			void forget_prepared()
+			{
+				prepared_id_.clear();
+			}
 		private:
 			void check(int col)
 			{
 				if(col < 1 || col > int(params_))
 					throw invalid_placeholder();
 			}
+			// wrap res_, the result object is reused if the previous one is not referenced any more
+			result *make_result()
+			{
+				result *r;
+				if(!result_) {
+					r = result_ = new result(res_,conn_,blob_);
+					result_->keep_for_reuse(true);
+				}
+				else if(result_->use_count() == 0) {
+					r = result_;
+					r->reuse(res_);
+				}
+				else {
+					r = new result(res_,conn_,blob_);
+				}
+				res_ = 0;
+				return r;
+			}
+			// wait for the result of the statement sent by send_async(); the connection accepts new
+			// commands only after PQgetResult returned NULL
+			void collect_async()
+			{
+				async_pending_ = false;
+				res_ = PQgetResult(conn_);
+				PGresult *extra;
+				while((extra = PQgetResult(conn_))!=0)
+					PQclear(extra);
+				if(!res_)
+					throw pqerror(conn_,"failed to get query result");
+			}
+			void discard_async()
+			{
+				if(!async_pending_)
+					return;
+				async_pending_ = false;
+				PGresult *r;
+				while((r = PQgetResult(conn_))!=0)
+					PQclear(r);
+			}
 			PGresult *res_;
 			PGconn *conn_;
 
@@ -650,9 +767,16 @@ namespace cppdb {
 			std::string prepared_id_;
 			std::stringstream fmt_;
 			blob_type blob_;
+			bool async_pending_;
+			// the parameters passed to libpq, kept between executions
+			std::vector<char const *> query_values_;
+			std::vector<int> query_lengths_;
+			std::vector<int> query_formats_;
+			// kept for reuse by the next query
+			result *result_;
 		};
 
-		class connection : public backend::connection {
+		class connection : public backend::connection, public backend::async_connection {
 		public:
 			void do_simple_exec(char const *s)
 			{
@@ -689,6 +813,82 @@ namespace cppdb {
 			{
 				return new statement(conn_,q,blob_,0);
 			}
+#ifdef LIBPQ_HAS_PIPELINING
+			///
+			/// Send all the preparations in a single pipeline, so a new connection pays one
+			/// round trip rather than one per statement. Each one is followed by its own sync point
+			/// such that a failing statement does not abort the rest.
+			///
+			virtual void prepare_statements(std::vector<std::string> const &queries,std::vector<backend::statement *> &out)
+			{
+				if(queries.empty())
+					return;
+				if(PQenterPipelineMode(conn_)!=1) {
+					backend::connection::prepare_statements(queries,out);
+					return;
+				}
+				std::vector<statement *> sent;
+				std::vector<bool> ok;
+				sent.reserve(queries.size());
+				try {
+					for(size_t i=0;i<queries.size();i++) {
+						std::unique_ptr<statement> st(new statement(conn_,queries[i],blob_,++prepared_id_,false));
+						if(PQsendPrepare(conn_,st->prepared_name().c_str(),st->native_query().c_str(),0,0)!=1) {
+							st->forget_prepared();
+							throw pqerror(conn_,"failed to send statement preparation");
+						}
+						sent.push_back(st.release());
+						if(PQpipelineSync(conn_)!=1)
+							throw pqerror(conn_,"failed to sync pipeline");
+					}
+					ok.resize(sent.size(),false);
+					for(size_t i=0;i<sent.size();i++)
+						ok[i] = read_pipeline_result();
+				}
+				catch(...) {
+					// the state of the server side is unknown
+					PQexitPipelineMode(conn_);
+					for(size_t i=0;i<sent.size();i++) {
+						sent[i]->forget_prepared();
+						delete sent[i];
+					}
+					throw;
+				}
+				PQexitPipelineMode(conn_);
+				for(size_t i=0;i<sent.size();i++) {
+					if(ok[i]) {
+						out.push_back(sent[i]);
+					}
+					else {
+						sent[i]->forget_prepared();
+						delete sent[i];
+					}
+				}
+			}
+			// read all results up to the next sync point, returns true if the command succeeded
+			bool read_pipeline_result()
+			{
+				bool ok = true;
+				int empty = 0;
+				for(;;) {
+					PGresult *r = PQgetResult(conn_);
+					if(!r) {
+						// a null separates the results of different commands, more of them
+						// in a row means that nothing is going to come
+						if(++empty > 1 || PQstatus(conn_)!=CONNECTION_OK)
+							throw pqerror(conn_,"failed to read pipeline result");
+						continue;
+					}
+					empty = 0;
+					ExecStatusType status = PQresultStatus(r);
+					PQclear(r);
+					if(status == PGRES_PIPELINE_SYNC)
+						return ok;
+					if(status != PGRES_COMMAND_OK)
+						ok = false;
+				}
+			}
+#endif
 			std::string do_escape(char const *b,size_t length)
 			{
 				std::vector<char> buf(2*length+1);
@@ -768,6 +968,7 @@ namespace cppdb {
 			}
 			virtual ~connection()
 			{
+				pending_.reset();
 				PQfinish(conn_);
 			}
 			virtual std::string driver()
@@ -778,7 +979,36 @@ namespace cppdb {
 			{
 				return "postgresql";
 			}
+			virtual std::string returning_query(std::string const &q,std::string const &column)
+			{
+				return q + " RETURNING " + column;
+			}
+			virtual int native_socket()
+			{
+				return PQsocket(conn_);
+			}
+			virtual void start_query(std::string const &q,params const &values)
+			{
+				if(pending_)
+					throw pqerror("another query is already in progress");
+				ref_ptr<backend::statement> st = prepare(q);
+				st->bind_params(1,values);
+				st->send_async();
+				pending_ = st;
+			}
+			virtual bool poll_result(ref_ptr<backend::result> &res,unsigned long long &affected)
+			{
+				if(!pending_)
+					throw pqerror("no query is in progress");
+				if(!pending_->async_ready())
+					return false;
+				ref_ptr<backend::statement> st;
+				st.swap(pending_);
+				res = static_cast<statement *>(st.get())->collect(affected);
+				return true;
+			}
 		private:
+			ref_ptr<backend::statement> pending_;
 			PGconn *conn_;
 			unsigned long long prepared_id_;
 			blob_type blob_;
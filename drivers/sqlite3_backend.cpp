@@ -29,6 +29,8 @@
 #include <limits>
 #include <iomanip>
 #include <map>
+#include <algorithm>
+#include <vector>
 #include <stdlib.h>
 #include <string.h>
 
@@ -45,6 +47,17 @@ namespace cppdb {
 			{
 				cols_=sqlite3_column_count(st_);
 			}
+			// prepare the object kept by the statement for the next query
+			void reuse()
+			{
+				// the statement may be prepared again after a schema change, so the
+				// names are looked up again even if the number of columns is the same
+				cols_ = sqlite3_column_count(st_);
+				if(column_names_prepared_) {
+					column_names_.clear();
+					column_names_prepared_ = false;
+				}
+			}
 			virtual ~result() 
 			{
 				st_ = 0;
@@ -154,9 +167,10 @@ namespace cppdb {
 			{
 				if(do_is_null(col))
 					return false;
-				char const *txt = (char const *)sqlite3_column_text(st_,col);
+				// blob access does not convert the value or add a terminating NUL
+				char const *data = (char const *)sqlite3_column_blob(st_,col);
 				int size = sqlite3_column_bytes(st_,col);
-				v.write(txt,size);
+				v.write(data,size);
 				return true;
 			}
 			virtual bool fetch(int col,std::tm &v)
@@ -218,12 +232,49 @@ namespace cppdb {
 			int cols_;
 		};
 
+		static const int blob_chunk_size = 65536;
+
+		class blob_guard {
+			blob_guard(blob_guard const &);
+			void operator=(blob_guard const &);
+		public:
+			blob_guard(sqlite3 *conn,std::string const &table,std::string const &column,long long rowid,bool write) :
+				conn_(conn),
+				blob_(0)
+			{
+				check(sqlite3_blob_open(conn_,"main",table.c_str(),column.c_str(),rowid,write ? 1 : 0,&blob_));
+			}
+			~blob_guard()
+			{
+				if(blob_)
+					sqlite3_blob_close(blob_);
+			}
+			sqlite3_blob *get()
+			{
+				return blob_;
+			}
+			void check(int r)
+			{
+				if(r != SQLITE_OK)
+					throw cppdb_error(std::string("sqlite3:") + sqlite3_errmsg(conn_));
+			}
+		private:
+			sqlite3 *conn_;
+			sqlite3_blob *blob_;
+		};
+
 		class statement : public backend::statement {
 		public:
 			virtual void reset()
 			{
 				reset_stat();
 				sqlite3_clear_bindings(st_);
+				drop_deferred();
+				// do not keep large blobs alive in cached statements
+				for(size_t i=0;i<owned_.size();i++) {
+					if(owned_[i].capacity() > blob_chunk_size)
+						std::string().swap(owned_[i]);
+				}
 			}
 			void reset_stat()
 			{
@@ -234,38 +285,42 @@ namespace cppdb {
 			}
 			virtual void bind(int col,std::string const &v) 
 			{
-				reset_stat();
-				check_bind(sqlite3_bind_text(st_,col,v.c_str(),v.size(),SQLITE_TRANSIENT));
+				defer_text(col,v.c_str(),v.size());
 			}
 			virtual void bind(int col,char const *s)
 			{
-				reset_stat();
-				check_bind(sqlite3_bind_text(st_,col,s,-1,SQLITE_TRANSIENT));
+				defer_text(col,s,-1);
 			}
 			virtual void bind(int col,char const *b,char const *e) 
 			{
-				reset_stat();
-				check_bind(sqlite3_bind_text(st_,col,b,e-b,SQLITE_TRANSIENT));
+				defer_text(col,b,e-b);
 			}
 			virtual void bind(int col,std::tm const &v)
 			{
 				reset_stat();
-				std::string tmp = cppdb::format_time(v);
-				check_bind(sqlite3_bind_text(st_,col,tmp.c_str(),tmp.size(),SQLITE_TRANSIENT));
+				check_col(col);
+				std::string &tmp = owned_[col-1];
+				tmp = cppdb::format_time(v);
+				check_bind(sqlite3_bind_text(st_,col,tmp.c_str(),tmp.size(),SQLITE_STATIC));
+				deferred_[col-1].ptr = 0;
 			}
 			virtual void bind(int col,std::istream &v) 
 			{
 				reset_stat();
-				// TODO Fix me
-				std::ostringstream ss;
-				ss<<v.rdbuf();
-				std::string tmp = ss.str();
-				check_bind(sqlite3_bind_text(st_,col,tmp.c_str(),tmp.size(),SQLITE_TRANSIENT));
+				check_col(col);
+				std::string &tmp = owned_[col-1];
+				tmp.clear();
+				char buf[4096];
+				while(v.read(buf,sizeof(buf)) || v.gcount() > 0)
+					tmp.append(buf,v.gcount());
+				check_bind(sqlite3_bind_blob(st_,col,tmp.c_str(),tmp.size(),SQLITE_STATIC));
+				deferred_[col-1].ptr = 0;
 			}
 			virtual void bind(int col,int v) 
 			{
 				reset_stat();
 				check_bind(sqlite3_bind_int(st_,col,v));
+				bound_directly(col);
 			}
 			template<typename IntType>
 			void do_bind(int col,IntType value)
@@ -277,6 +332,7 @@ namespace cppdb {
 				else
 					r = sqlite3_bind_int(st_,col,static_cast<int>(value));
 				check_bind(r);
+				bound_directly(col);
 			}
 			virtual void bind(int col,unsigned v) 
 			{
@@ -302,21 +358,37 @@ namespace cppdb {
 			{
 				reset_stat();
 				check_bind(sqlite3_bind_double(st_,col,v));
+				bound_directly(col);
 			}
 			virtual void bind(int col,long double v) 
 			{
 				reset_stat();
 				check_bind(sqlite3_bind_double(st_,col,static_cast<double>(v)));
+				bound_directly(col);
 			}
 			virtual void bind_null(int col)
 			{
 				reset_stat();
 				check_bind(sqlite3_bind_null(st_,col));
+				bound_directly(col);
 			}
 			virtual result *query()
 			{
 				reset_stat();
+				// the rows are fetched after query() returns, the text may be gone by then
+				apply_deferred(SQLITE_TRANSIENT);
+				drop_deferred();
 				reset_ = false;
+				if(!result_) {
+					result_ = new result(st_,conn_);
+					result_->keep_for_reuse(true);
+					return result_;
+				}
+				if(result_->use_count() == 0) {
+					result_->reuse();
+					return result_;
+				}
+				// previous result is still referenced
 				return new result(st_,conn_);
 			}
 			virtual long long sequence_last(std::string const &/*name*/)
@@ -326,15 +398,23 @@ namespace cppdb {
 			virtual void exec()
 			{
 				reset_stat();
+				apply_deferred(SQLITE_STATIC);
 				reset_ = false;
 				int r = sqlite3_step(st_);
-				if(r!=SQLITE_DONE) {
-					if(r==SQLITE_ROW) {
-						throw cppdb_error("Using exec with query!");
+				try {
+					if(r!=SQLITE_DONE) {
+						if(r==SQLITE_ROW) {
+							throw cppdb_error("Using exec with query!");
+						}
+						else 
+							check_bind(r);
 					}
-					else 
-						check_bind(r);
 				}
+				catch(...) {
+					own_deferred();
+					throw;
+				}
+				own_deferred();
 			}
 			virtual unsigned long long affected()
 			{
@@ -348,17 +428,91 @@ namespace cppdb {
 				st_(0),
 				conn_(conn),
 				reset_(true),
-				sql_query_(query)
+				sql_query_(query),
+				result_(0),
+				has_deferred_(false)
 			{
 				if(sqlite3_prepare_v2(conn_,query.c_str(),query.size(),&st_,0)!=SQLITE_OK)
 					throw cppdb_error(sqlite3_errmsg(conn_));
+				int params = sqlite3_bind_parameter_count(st_);
+				deferred_.resize(params);
+				owned_.resize(params);
 			}
 			~statement()
 			{
+				if(result_) {
+					if(result_->use_count() == 0)
+						delete result_;
+					else
+						result_->keep_for_reuse(false);
+				}
 				sqlite3_finalize(st_);
 			}
 
 		private:
+			///
+			/// Text is bound by reference: the caller keeps it valid until exec() or query()
+			/// so the actual binding is done there, allowing exec() to run the statement without
+			/// SQLite making its own copy.
+			///
+			void defer_text(int col,char const *ptr,int len)
+			{
+				reset_stat();
+				check_col(col);
+				text_ref &ref = deferred_[col-1];
+				ref.ptr = ptr;
+				ref.len = len;
+				has_deferred_ = true;
+			}
+			void apply_deferred(void (*destructor)(void *))
+			{
+				if(!has_deferred_)
+					return;
+				for(size_t i=0;i<deferred_.size();i++) {
+					text_ref const &ref = deferred_[i];
+					if(ref.ptr)
+						check_bind(sqlite3_bind_text(st_,i+1,ref.ptr,ref.len,destructor));
+				}
+			}
+			void drop_deferred()
+			{
+				if(!has_deferred_)
+					return;
+				for(size_t i=0;i<deferred_.size();i++)
+					deferred_[i].ptr = 0;
+				has_deferred_ = false;
+			}
+			///
+			/// The statement may be executed again without binding, but the caller's text is valid
+			/// only during exec(), so once executed it is bound again from a copy owned by the statement.
+			///
+			void own_deferred()
+			{
+				if(!has_deferred_)
+					return;
+				reset_stat();
+				for(size_t i=0;i<deferred_.size();i++) {
+					text_ref const &ref = deferred_[i];
+					if(!ref.ptr)
+						continue;
+					std::string &tmp = owned_[i];
+					if(ref.len < 0)
+						tmp.assign(ref.ptr);
+					else
+						tmp.assign(ref.ptr,ref.len);
+					check_bind(sqlite3_bind_text(st_,i+1,tmp.c_str(),tmp.size(),SQLITE_STATIC));
+				}
+				drop_deferred();
+			}
+			void bound_directly(int col)
+			{
+				deferred_[col-1].ptr = 0;
+			}
+			void check_col(int col)
+			{
+				if(col < 1 || col > int(deferred_.size()))
+					throw invalid_placeholder();
+			}
 			void check_bind(int v)
 			{
 				if(v==SQLITE_RANGE) {
@@ -372,6 +526,18 @@ namespace cppdb {
 			sqlite3 *conn_;
 			bool reset_;
 			std::string sql_query_;
+			// kept for reuse by the next query
+			result *result_;
+
+			struct text_ref {
+				text_ref() : ptr(0), len(0) {}
+				char const *ptr;
+				int len;
+			};
+			std::vector<text_ref> deferred_;
+			// values formatted by the statement itself, bound as SQLITE_STATIC
+			std::vector<std::string> owned_;
+			bool has_deferred_;
 		};
 		class connection : public backend::connection {
 		public:
@@ -401,6 +567,14 @@ namespace cppdb {
 				char const *cvfs = vfs.empty() ? (char const *)(0) : vfs.c_str();
 				
 				int busy = ci.get("busy_timeout",-1);
+
+				std::string journal = ci.get("journal_mode");
+				if(	!journal.empty() && journal != "delete" && journal != "truncate" && journal != "persist"
+					&& journal != "memory" && journal != "wal" && journal != "off")
+				{
+					throw cppdb_error("sqlite3:invalid journal_mode property, expected one of "
+								"'delete', 'truncate', 'persist', 'memory', 'wal' or 'off'");
+				}
 				
 				try {
 					if(sqlite3_open_v2(dbname.c_str(),&conn_,flags,cvfs)!=SQLITE_OK) {
@@ -416,6 +590,9 @@ namespace cppdb {
 					if(busy!=-1 && sqlite3_busy_timeout(conn_,busy)!=0) 
 						throw cppdb_error(std::string("sqlite3:Failed to set timeout:")
 							+ sqlite3_errmsg(conn_));
+					// journal mode is persistent for WAL, read only connections just use it
+					if(!journal.empty() && mode != "readonly")
+						fast_exec(("PRAGMA journal_mode=" + journal).c_str());
 				}
 				catch(...) {
 					if(conn_) {
@@ -479,6 +656,41 @@ namespace cppdb {
 			{
 				return "sqlite3";
 			}
+			virtual void blob_read(std::string const &table,std::string const &column,long long rowid,std::ostream &out)
+			{
+				blob_guard blob(conn_,table,column,rowid,false);
+				std::vector<char> buf(blob_chunk_size);
+				int size = sqlite3_blob_bytes(blob.get());
+				for(int offset = 0;offset < size;) {
+					int n = std::min(size - offset,int(buf.size()));
+					blob.check(sqlite3_blob_read(blob.get(),&buf[0],n,offset));
+					out.write(&buf[0],n);
+					if(!out)
+						throw cppdb_error("cppdb::sqlite3::failed to write blob to the stream");
+					offset += n;
+				}
+			}
+			virtual void blob_write(std::string const &table,std::string const &column,long long rowid,std::istream &in)
+			{
+				blob_guard blob(conn_,table,column,rowid,true);
+				std::vector<char> buf(blob_chunk_size);
+				int size = sqlite3_blob_bytes(blob.get());
+				int offset = 0;
+				while(in.read(&buf[0],buf.size()) || in.gcount() > 0) {
+					int n = in.gcount();
+					if(n > size - offset)
+						throw cppdb_error("cppdb::sqlite3::the stream is larger than the blob, create it using zeroblob() of the right size");
+					blob.check(sqlite3_blob_write(blob.get(),&buf[0],n,offset));
+					offset += n;
+				}
+			}
+			virtual std::string returning_query(std::string const &q,std::string const &column)
+			{
+				// RETURNING clause is supported since 3.35.0
+				if(sqlite3_libversion_number() < 3035000)
+					return std::string();
+				return q + " RETURNING " + column;
+			}
 		private:
 			void fast_exec(char const *query)
 			{
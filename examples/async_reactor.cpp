@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// A minimal poll(2) based reactor that runs many concurrent queries over
+// a few connections using backend::async_connection interface.
+//
+// Usage: async_reactor [connection_string]
+//
+#include <cppdb/backend.h>
+#include <cppdb/driver_manager.h>
+#include <cppdb/params.h>
+#include <cppdb/errors.h>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <poll.h>
+
+struct channel {
+	cppdb::ref_ptr<cppdb::backend::connection> conn;
+	cppdb::backend::async_connection *async;
+	int query_no; // the query in progress, -1 if idle
+};
+
+int main(int argc,char **argv)
+{
+	std::string cs = "postgresql:dbname=test";
+	if(argc >= 2)
+		cs = argv[1];
+
+	int const connections = 4;
+	int const queries = 1000;
+
+	try {
+		std::vector<channel> channels(connections);
+		for(int i=0;i<connections;i++) {
+			channels[i].conn = cppdb::driver_manager::instance().connect(cs);
+			channels[i].async = dynamic_cast<cppdb::backend::async_connection *>(channels[i].conn.get());
+			channels[i].query_no = -1;
+			if(!channels[i].async) {
+				std::cerr << "The backend " << channels[i].conn->driver() << " does not support asynchronous queries" << std::endl;
+				return 1;
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int started = 0;
+		int completed = 0;
+		cppdb::params values;
+		std::vector<pollfd> fds(connections);
+
+		while(completed < queries) {
+			for(int i=0;i<connections;i++) {
+				channel &ch = channels[i];
+				if(ch.query_no < 0 && started < queries) {
+					values.clear();
+					values << started;
+					ch.async->start_query("SELECT CAST(? AS integer) * 2",values);
+					ch.query_no = started++;
+				}
+				fds[i].fd = ch.query_no < 0 ? -1 : ch.async->native_socket();
+				fds[i].events = POLLIN;
+				fds[i].revents = 0;
+			}
+			if(poll(&fds[0],fds.size(),-1) < 0) {
+				std::cerr << "poll failed" << std::endl;
+				return 1;
+			}
+			for(int i=0;i<connections;i++) {
+				channel &ch = channels[i];
+				if(fds[i].revents == 0)
+					continue;
+				cppdb::ref_ptr<cppdb::backend::result> res;
+				unsigned long long affected = 0;
+				if(!ch.async->poll_result(res,affected))
+					continue;
+				int value = -1;
+				if(!res || !res->next() || !res->fetch(0,value) || value != ch.query_no * 2) {
+					std::cerr << "Unexpected result of query " << ch.query_no << std::endl;
+					return 1;
+				}
+				ch.query_no = -1;
+				completed++;
+			}
+		}
+
+		double passed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << completed << " queries over " << connections << " connections in " << passed << "s" << std::endl;
+	}
+	catch(std::exception const &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
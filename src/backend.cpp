@@ -19,19 +19,125 @@
 #include <cppdb/backend.h>
 #include <cppdb/utils.h>
 #include <cppdb/pool.h>
+#include <cppdb/params.h>
+#include <cppdb/stats.h>
 
 #include <map>
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <string.h>
 
 namespace cppdb {
+	namespace {
+		typedef std::vector<std::shared_ptr<query_observer> > observers_type;
+
+		struct global_observers {
+			std::mutex lock;
+			std::shared_ptr<observers_type const> list;
+			static global_observers &instance()
+			{
+				static global_observers inst;
+				return inst;
+			}
+		};
+		std::atomic<bool> global_observers_installed(false);
+
+		void notify_all(observers_type const &observers,query_event const &e)
+		{
+			for(size_t i=0;i<observers.size();i++) {
+				try {
+					observers[i]->on_event(e);
+				}
+				catch(...) {}
+			}
+		}
+	}
+
+	void add_global_observer(std::shared_ptr<query_observer> const &o)
+	{
+		global_observers &g = global_observers::instance();
+		std::lock_guard<std::mutex> l(g.lock);
+		std::shared_ptr<observers_type> list(g.list ? new observers_type(*g.list) : new observers_type());
+		list->push_back(o);
+		g.list = list;
+		global_observers_installed = true;
+	}
+
+	void remove_global_observer(query_observer *o)
+	{
+		global_observers &g = global_observers::instance();
+		std::lock_guard<std::mutex> l(g.lock);
+		if(!g.list)
+			return;
+		std::shared_ptr<observers_type> list(new observers_type());
+		for(size_t i=0;i<g.list->size();i++) {
+			if((*g.list)[i].get() != o)
+				list->push_back((*g.list)[i]);
+		}
+		if(list->empty()) {
+			g.list.reset();
+			global_observers_installed = false;
+		}
+		else
+			g.list = list;
+	}
+
 	namespace backend {
 		//result
 		struct result::data {};
-		result::result() {}
+		result::result() : keep_for_reuse_(false) {}
 		result::~result() {}
+		void result::keep_for_reuse(bool v)
+		{
+			keep_for_reuse_ = v;
+		}
+		void result::dispose(result *p)
+		{
+			if(p && !p->keep_for_reuse_)
+				delete p;
+		}
 		
 		//statement
-		struct statement::data {};
+		struct statement::data {
+			data() : cols(-1), named(false) {}
+			// lookups cache, valid for results with cols columns named columns
+			int cols;
+			bool named;
+			std::vector<std::string> columns;
+			// the results of name_to_column() sorted by the requested name, so the backend
+			// rules like case folding or precedence of duplicate names are kept
+			typedef std::vector<std::pair<std::string,int> > names_type;
+			names_type names;
+
+			struct name_less {
+				bool operator()(names_type::value_type const &l,char const *r) const
+				{
+					return strcmp(l.first.c_str(),r) < 0;
+				}
+			};
+
+			void reset(result &r,int n)
+			{
+				cols = n;
+				names.clear();
+				columns.clear();
+				named = false;
+				try {
+					columns.reserve(n);
+					for(int i=0;i<n;i++)
+						columns.push_back(r.column_to_name(i));
+				}
+				catch(cppdb_error const &) {
+					// backend can't provide names, use name_to_column only
+					columns.clear();
+					return;
+				}
+				named = true;
+			}
+		};
 
 		statement::statement() : cache_(0) 
 		{
@@ -44,6 +150,77 @@ namespace cppdb {
 			cache_ = c;
 		}
 
+		void statement::bind_params(int first_col,params const &values)
+		{
+			for(size_t i=0;i<values.size();i++) {
+				int col = first_col + int(i);
+				switch(values.type(i)) {
+				case params::null_type:
+					bind_null(col);
+					break;
+				case params::int_type:
+					bind(col,values.as_int(i));
+					break;
+				case params::uint_type:
+					bind(col,values.as_uint(i));
+					break;
+				case params::real_type:
+					bind(col,values.as_real(i));
+					break;
+				case params::text_type:
+					{
+						std::string const &v = values.as_text(i);
+						bind(col,v.c_str(),v.c_str()+v.size());
+					}
+					break;
+				case params::time_type:
+					bind(col,values.as_time(i));
+					break;
+				}
+			}
+		}
+
+		bool statement::send_async()
+		{
+			return false;
+		}
+		bool statement::async_ready()
+		{
+			return true;
+		}
+		int statement::async_socket()
+		{
+			return -1;
+		}
+
+		int statement::find_column(result &r,char const *name)
+		{
+			if(!d)
+				d.reset(new data());
+			int n = r.cols();
+			if(d->cols != n)
+				d->reset(r,n);
+			if(!d->named) {
+				int c = r.name_to_column(name);
+				return c < 0 ? -1 : c;
+			}
+			data::names_type::iterator p = 
+				std::lower_bound(d->names.begin(),d->names.end(),name,data::name_less());
+			if(p!=d->names.end() && p->first == name) {
+				// the columns may be renamed keeping their number, for example when
+				// a cached statement is prepared again after a schema change
+				if(r.column_to_name(p->second) == d->columns[p->second])
+					return p->second;
+				d->reset(r,n);
+				p = d->names.begin();
+			}
+			int c = r.name_to_column(name);
+			if(c < 0 || c >= n)
+				return c < 0 ? -1 : c;
+			d->names.insert(p,std::make_pair(std::string(name),c));
+			return c;
+		}
+
 		void statement::dispose(statement *p)
 		{
 			if(!p)
@@ -63,13 +240,23 @@ namespace cppdb {
 
 			data() : 
 				size(0),
-				max_size(0) 
+				max_size(0),
+				hits(0),
+				misses(0),
+				evictions(0),
+				reprepares(0)
 			{
 			}
 
 			struct entry;
-			typedef std::map<std::string,entry> statements_type;
+			// transparent comparison allows lookup by char const * without creating a string
+			typedef std::map<std::string,entry,std::less<> > statements_type;
 			typedef std::list<statements_type::iterator> lru_type;
+			//
+			// Entries of the statements fetched from cache stay in the map with empty stat
+			// and their LRU nodes are moved to spare list, so fetching and putting a statement
+			// back does not allocate or free memory.
+			//
 			struct entry {
 				ref_ptr<statement> stat;
 				lru_type::iterator lru_ptr;
@@ -77,44 +264,108 @@ namespace cppdb {
 			
 			statements_type statements;
 			lru_type lru;
+			lru_type spare;
 			size_t size;
 			size_t max_size;
 
+			// counters
+			unsigned long long hits;
+			unsigned long long misses;
+			unsigned long long evictions;
+			unsigned long long reprepares;
+			statement_cache_stats collected;
+			// up to max_size most recently evicted queries, most recent first
+			typedef std::list<std::string> evicted_type;
+			evicted_type evicted;
+			std::map<std::string,evicted_type::iterator,std::less<> > evicted_index;
 
 			void insert(ref_ptr<statement> st)
 			{
 				statements_type::iterator p;
 				if((p=statements.find(st->sql_query()))!=statements.end()) {
-					p->second.stat = st;
-					lru.erase(p->second.lru_ptr);
-					lru.push_front(p);
-					p->second.lru_ptr = lru.begin();
+					if(p->second.stat) {
+						p->second.stat = st;
+						lru.splice(lru.begin(),lru,p->second.lru_ptr);
+						return;
+					}
 				}
 				else {
-					if(size > 0 && size >= max_size) {
-						statements.erase(lru.back());
-						lru.pop_back();
-						size--;
-					}
-					std::pair<statements_type::iterator,bool> ins = 
-						statements.insert(std::make_pair(st->sql_query(),entry()));
-					p = ins.first;
-					p->second.stat = st;
+					p = statements.insert(std::make_pair(st->sql_query(),entry())).first;
+				}
+				if(size > 0 && size >= max_size) {
+					evict();
+				}
+				if(spare.empty())
 					lru.push_front(p);
-					p->second.lru_ptr = lru.begin();
-					size ++;
+				else {
+					lru.splice(lru.begin(),spare,spare.begin());
+					lru.front() = p;
+				}
+				p->second.stat = st;
+				p->second.lru_ptr = lru.begin();
+				size ++;
+			}
+
+			void evict()
+			{
+				statements_type::iterator p = lru.back();
+				lru.pop_back();
+				remember_evicted(p->first);
+				statements.erase(p);
+				size--;
+				evictions++;
+			}
+
+			void remember_evicted(std::string const &q)
+			{
+				if(evicted_index.find(q)!=evicted_index.end())
+					return;
+				evicted.push_front(q);
+				evicted_index[q] = evicted.begin();
+				if(evicted.size() > max_size) {
+					evicted_index.erase(evicted.back());
+					evicted.pop_back();
 				}
 			}
 
-			ref_ptr<statement> fetch(std::string const &query)
+			template<typename Query>
+			void count_miss(Query const &query)
+			{
+				misses++;
+				if(evicted.empty())
+					return;
+				std::map<std::string,evicted_type::iterator,std::less<> >::iterator p = evicted_index.find(query);
+				if(p==evicted_index.end())
+					return;
+				reprepares++;
+				evicted.erase(p->second);
+				evicted_index.erase(p);
+			}
+
+			statement_cache_stats stats() const
+			{
+				statement_cache_stats s;
+				s.hits = hits;
+				s.misses = misses;
+				s.evictions = evictions;
+				s.reprepares = reprepares;
+				s.size = size;
+				s.capacity = max_size;
+				return s;
+			}
+
+			template<typename Query>
+			ref_ptr<statement> fetch(Query const &query)
 			{
 				ref_ptr<statement> st;
 				statements_type::iterator p = statements.find(query);
-				if(p==statements.end())
+				if(p==statements.end() || !p->second.stat) {
+					count_miss(query);
 					return st;
-				st=p->second.stat;
-				lru.erase(p->second.lru_ptr);
-				statements.erase(p);
+				}
+				hits++;
+				st.swap(p->second.stat);
+				spare.splice(spare.begin(),lru,p->second.lru_ptr);
 				size --;
 				return st;
 			}
@@ -122,6 +373,7 @@ namespace cppdb {
 			void clear()
 			{
 				lru.clear();
+				spare.clear();
 				statements.clear();
 				size=0;
 			}
@@ -141,6 +393,7 @@ namespace cppdb {
 		{
 			if(!active()) {
 				delete p_in;
+				return;
 			}
 			ref_ptr<statement> p(p_in);
 			p->reset();
@@ -152,10 +405,35 @@ namespace cppdb {
 				return 0;
 			return d->fetch(q);
 		}
+		ref_ptr<statement> statements_cache::fetch(char const *q)
+		{
+			if(!active())
+				return 0;
+			return d->fetch(q);
+		}
 		void statements_cache::clear()
 		{
 			d->clear();
 		}
+		statement_cache_stats statements_cache::stats()
+		{
+			if(!active())
+				return statement_cache_stats();
+			return d->stats();
+		}
+		statement_cache_stats statements_cache::collect()
+		{
+			if(!active())
+				return statement_cache_stats();
+			statement_cache_stats now = d->stats();
+			statement_cache_stats delta = now;
+			delta.hits -= d->collected.hits;
+			delta.misses -= d->collected.misses;
+			delta.evictions -= d->collected.evictions;
+			delta.reprepares -= d->collected.reprepares;
+			d->collected = now;
+			return delta;
+		}
 		statements_cache::~statements_cache()
 		{
 		}
@@ -172,6 +450,10 @@ namespace cppdb {
 		struct connection::data {
 			typedef std::list<connection_specific_data *> conn_specific_type;
 			conn_specific_type conn_specific;
+			data() : capture_params(false) {}
+			std::string affinity;
+			observers_type observers;
+			bool capture_params;
 			~data()
 			{
 				for(conn_specific_type::iterator p=conn_specific.begin();p!=conn_specific.end();++p)
@@ -186,9 +468,70 @@ namespace cppdb {
 				return get_statement(q);
 		}
 		
+		ref_ptr<statement> connection::prepare(char const *q) 
+		{
+			if(default_is_prepared_)
+				return get_prepared_statement(q);
+			else
+				return get_statement(q);
+		}
+		
+		namespace {
+			statement *observed_create(connection &c,std::string const &q,bool prepared)
+			{
+				if(!c.observed())
+					return prepared ? c.prepare_statement(q) : c.create_statement(q);
+				query_event e(query_event::prepare_event);
+				e.sql = q.c_str();
+				e.conn = &c;
+				e.start = query_event::clock_type::now();
+				statement *st = 0;
+				try {
+					st = prepared ? c.prepare_statement(q) : c.create_statement(q);
+				}
+				catch(std::exception const &err) {
+					e.time = query_event::clock_type::now();
+					e.type = query_event::error_event;
+					e.error = err.what();
+					c.notify(e);
+					throw;
+				}
+				e.time = query_event::clock_type::now();
+				// the same text as of the later events of this statement, q may be a temporary
+				e.sql = st->sql_query().c_str();
+				c.notify(e);
+				return st;
+			}
+			void observed_exec(connection &c,statement &st,int params)
+			{
+				if(!c.observed()) {
+					st.exec();
+					return;
+				}
+				query_event e(query_event::execute_event);
+				e.sql = st.sql_query().c_str();
+				e.conn = &c;
+				e.params = params;
+				e.start = query_event::clock_type::now();
+				try {
+					st.exec();
+					e.affected = st.affected();
+				}
+				catch(std::exception const &err) {
+					e.time = query_event::clock_type::now();
+					e.type = query_event::error_event;
+					e.error = err.what();
+					c.notify(e);
+					throw;
+				}
+				e.time = query_event::clock_type::now();
+				c.notify(e);
+			}
+		}
+
 		ref_ptr<statement> connection::get_statement(std::string const &q)
 		{
-			ref_ptr<statement> st = create_statement(q);
+			ref_ptr<statement> st = observed_create(*this,q,false);
 			return st;
 		}
 
@@ -196,19 +539,37 @@ namespace cppdb {
 		{
 			ref_ptr<statement> st;
 			if(!cache_.active()) {
-				st = prepare_statement(q);
+				st = observed_create(*this,q,true);
 				return st;
 			}
 			st = cache_.fetch(q);
-			if(!st)
-				st = prepare_statement(q);
+			if(!st) {
+				st = observed_create(*this,q,true);
+				if(pool_)
+					pool_->statement_prepared(q);
+			}
+			st->cache(&cache_);
+			return st;
+		}
+
+		ref_ptr<statement> connection::get_prepared_statement(char const *q)
+		{
+			if(!cache_.active())
+				return get_prepared_statement(std::string(q));
+			ref_ptr<statement> st = cache_.fetch(q);
+			if(!st) {
+				std::string query(q);
+				st = observed_create(*this,query,true);
+				if(pool_)
+					pool_->statement_prepared(query);
+			}
 			st->cache(&cache_);
 			return st;
 		}
 
 		ref_ptr<statement> connection::get_prepared_uncached_statement(std::string const &q)
 		{
-			ref_ptr<statement> st = prepare_statement(q);
+			ref_ptr<statement> st = observed_create(*this,q,true);
 			return st;
 		}
 
@@ -229,6 +590,16 @@ namespace cppdb {
 				default_is_prepared_ = 0;
 			else
 				throw cppdb_error("cppdb::backend::connection: @use_prepared should be either 'on' or 'off'");
+			std::string query_stats = info.get("@query_stats","off");
+			if(query_stats == "on")
+				add_observer(stats::observer());
+			else if(query_stats != "off")
+				throw cppdb_error("cppdb::backend::connection: @query_stats should be either 'on' or 'off'");
+			int slow_query_ms = info.get("@slow_query_ms",0);
+			if(slow_query_ms > 0) {
+				add_observer(stats::slow_query_observer(std::chrono::milliseconds(slow_query_ms)));
+				capture_params(true);
+			}
 		}
 		connection::~connection()
 		{
@@ -296,6 +667,114 @@ namespace cppdb {
 		{
 			pool_ = p;
 		}
+		std::string const &connection::affinity() const
+		{
+			return d->affinity;
+		}
+		void connection::affinity(std::string const &tag)
+		{
+			d->affinity = tag;
+		}
+		void connection::prepare_statements(std::vector<std::string> const &queries,std::vector<statement *> &out)
+		{
+			for(size_t i=0;i<queries.size();i++) {
+				try {
+					std::unique_ptr<statement> st(prepare_statement(queries[i]));
+					out.push_back(st.get());
+					st.release();
+				}
+				catch(cppdb_error const &) {
+				}
+			}
+		}
+		namespace {
+			std::string make_insert(std::string const &table,std::vector<std::string> const &columns,size_t rows)
+			{
+				std::string q = "INSERT INTO " + table + "(";
+				for(size_t i=0;i<columns.size();i++) {
+					if(i > 0)
+						q += ",";
+					q += columns[i];
+				}
+				q += ") VALUES ";
+				for(size_t r=0;r<rows;r++) {
+					q += r > 0 ? ",(" : "(";
+					for(size_t i=0;i<columns.size();i++)
+						q += i > 0 ? ",?" : "?";
+					q += ")";
+				}
+				return q;
+			}
+		}
+
+		unsigned long long connection::bulk_load(std::string const &table,std::vector<std::string> const &columns,bulk_source &source)
+		{
+			if(columns.empty())
+				throw cppdb_error("cppdb::bulk_load: no columns given");
+			// keep below the lowest common limit of placeholders per statement (SQLite's 999)
+			size_t batch = 999 / columns.size();
+			if(batch > 100)
+				batch = 100;
+			if(batch == 0)
+				batch = 1;
+			std::vector<params> rows(batch);
+			std::string full_batch = make_insert(table,columns,batch);
+			unsigned long long total = 0;
+			size_t n;
+			do {
+				for(n=0;n<batch;n++) {
+					rows[n].clear();
+					if(!source.next(rows[n]))
+						break;
+					if(rows[n].size()!=columns.size())
+						throw cppdb_error("cppdb::bulk_load: number of values in a row differs from number of columns");
+				}
+				if(n == 0)
+					break;
+				// the tail is executed only once, no need to keep it in cache
+				ref_ptr<statement> st = n == batch ? prepare(full_batch) : get_statement(make_insert(table,columns,n));
+				for(size_t i=0;i<n;i++)
+					st->bind_params(int(i * columns.size() + 1),rows[i]);
+				observed_exec(*this,*st,int(n * columns.size()));
+				total += n;
+			} while(n == batch);
+			return total;
+		}
+
+		void connection::blob_read(std::string const &/*table*/,std::string const &/*column*/,long long /*rowid*/,std::ostream &/*out*/)
+		{
+			throw not_supported_by_backend("cppdb::blob_read is not supported by " + driver() + " backend");
+		}
+		void connection::blob_write(std::string const &/*table*/,std::string const &/*column*/,long long /*rowid*/,std::istream &/*in*/)
+		{
+			throw not_supported_by_backend("cppdb::blob_write is not supported by " + driver() + " backend");
+		}
+		std::string connection::returning_query(std::string const &/*q*/,std::string const &/*column*/)
+		{
+			return std::string();
+		}
+
+		void connection::warm_up(std::vector<std::string> const &queries)
+		{
+			if(!default_is_prepared_ || !cache_.active() || queries.empty())
+				return;
+			std::vector<statement *> prepared;
+			prepared.reserve(queries.size());
+			try {
+				prepare_statements(queries,prepared);
+			}
+			catch(...) {
+				for(size_t i=0;i<prepared.size();i++)
+					delete prepared[i];
+				throw;
+			}
+			for(size_t i=0;i<prepared.size();i++) {
+				ref_ptr<statement> st(prepared[i]);
+				prepared[i] = 0;
+				// returned to cache on release
+				st->cache(&cache_);
+			}
+		}
 		void connection::set_driver(ref_ptr<loadable_driver> p)
 		{
 			driver_ = p;
@@ -304,6 +783,14 @@ namespace cppdb {
 		{
 			cache_.clear();
 		}
+		statement_cache_stats connection::cache_stats()
+		{
+			return cache_.stats();
+		}
+		statement_cache_stats connection::collect_cache_stats()
+		{
+			return cache_.collect();
+		}
 
 		void connection::recyclable(bool opt)
 		{
@@ -314,16 +801,58 @@ namespace cppdb {
 		{
 			return recyclable_;
 		}
+
+		void connection::add_observer(std::shared_ptr<query_observer> const &o)
+		{
+			d->observers.push_back(o);
+		}
+		void connection::remove_observer(query_observer *o)
+		{
+			for(observers_type::iterator p=d->observers.begin();p!=d->observers.end();++p) {
+				if(p->get() == o) {
+					d->observers.erase(p);
+					return;
+				}
+			}
+		}
+		bool connection::observed() const
+		{
+			return !d->observers.empty() || global_observers_installed.load(std::memory_order_relaxed);
+		}
+		void connection::capture_params(bool v)
+		{
+			d->capture_params = v;
+		}
+		bool connection::capture_params() const
+		{
+			return d->capture_params;
+		}
+		void connection::notify(query_event const &e)
+		{
+			notify_all(d->observers,e);
+			if(!global_observers_installed.load(std::memory_order_relaxed))
+				return;
+			std::shared_ptr<observers_type const> globals;
+			{
+				global_observers &g = global_observers::instance();
+				std::lock_guard<std::mutex> l(g.lock);
+				globals = g.list;
+			}
+			if(globals)
+				notify_all(*globals,e);
+		}
 		
 		void connection::dispose(connection *c)
 		{
 			if(!c)
 				return;
-			ref_ptr<pool> p = c->pool_;
-			c->pool_ = 0;
+			ref_ptr<pool> p;
+			p.swap(c->pool_);
 			if(p && c->recyclable())
 				p->put(c);
 			else {
+				if(p)
+					p->discard(c);
 				c->clear_cache();
 				// Make sure that driver would not be
 				// destoryed destructor of connection exits
@@ -43,6 +43,14 @@ namespace cppdb {
 	}
 
 	ref_ptr<backend::connection> connections_manager::open(std::string const &cs)
+	{
+		return open(cs,std::string());
+	}
+	ref_ptr<backend::connection> connections_manager::open(connection_info const &ci)
+	{
+		return open(ci,std::string());
+	}
+	ref_ptr<backend::connection> connections_manager::open(std::string const &cs,std::string const &affinity)
 	{
 		ref_ptr<pool> p;
 		/// seems we may be using pool
@@ -54,28 +62,45 @@ namespace cppdb {
 		}
 
 		if(p) {
-			return p->open();
+			return p->open(affinity);
 		}
 		else {
 			connection_info ci(cs);
-			return open(ci);
+			return open(ci,affinity);
 		}
 	}
-	ref_ptr<backend::connection> connections_manager::open(connection_info const &ci)
+	ref_ptr<backend::connection> connections_manager::open(connection_info const &ci,std::string const &affinity)
 	{
 		if(ci.get("@pool_size",0)==0) {
 			return driver_manager::instance().connect(ci);
 		}
-		ref_ptr<pool> p;
-		{
-			std::lock_guard<std::mutex> l(lock_);
-			ref_ptr<pool> &ref_p = connections_[ci.connection_string];
-			if(!ref_p) {
-				ref_p = pool::create(ci);
-			}
-			p=ref_p;
+		return get_pool(ci)->open(affinity);
+	}
+	ref_ptr<backend::connection> connections_manager::open_writer(std::string const &cs)
+	{
+		connection_info ci(cs);
+		return open_writer(ci);
+	}
+	ref_ptr<backend::connection> connections_manager::open_writer(connection_info const &ci)
+	{
+		if(ci.get("@pool_size",0)==0) {
+			return driver_manager::instance().connect(ci);
 		}
-		return p->open();
+		return get_pool(ci)->open_writer();
+	}
+	ref_ptr<pool> connections_manager::get_pool(connection_info const &ci)
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		ref_ptr<pool> &ref_p = connections_[ci.connection_string];
+		if(!ref_p) {
+			ref_p = pool::create(ci);
+		}
+		return ref_p;
+	}
+	std::map<std::string,ref_ptr<pool> > connections_manager::pools()
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		return connections_;
 	}
 	void connections_manager::gc()
 	{
@@ -20,9 +20,135 @@
 #include <cppdb/backend.h>
 #include <cppdb/conn_manager.h>
 #include <cppdb/pool.h>
+#include <cppdb/observer.h>
+#include <cppdb/params.h>
+#include <cppdb/utils.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 
 namespace cppdb {
-	struct result::data {};
+	namespace {
+		//
+		// Bounded pool of threads executing statements of the backends that can't do it asynchronously,
+		// the threads are created on demand
+		//
+		class async_executor {
+			async_executor(async_executor const &);
+			void operator=(async_executor const &);
+		public:
+			static async_executor &instance()
+			{
+				static async_executor executor;
+				return executor;
+			}
+			void post(std::function<void()> task)
+			{
+				std::unique_lock<std::mutex> l(lock_);
+				if(stop_ || queue_.size() >= max_queue_) {
+					l.unlock();
+					// overloaded, execute in the caller's thread
+					task();
+					return;
+				}
+				queue_.push_back(std::move(task));
+				if(idle_ == 0 && workers_.size() < max_threads_)
+					workers_.push_back(std::thread(&async_executor::run,this));
+				l.unlock();
+				wake_.notify_one();
+			}
+		private:
+			async_executor() :
+				max_threads_(std::thread::hardware_concurrency()),
+				max_queue_(1024),
+				idle_(0),
+				stop_(false)
+			{
+				if(max_threads_ < 2)
+					max_threads_ = 2;
+				else if(max_threads_ > 16)
+					max_threads_ = 16;
+			}
+			~async_executor()
+			{
+				{
+					std::lock_guard<std::mutex> l(lock_);
+					stop_ = true;
+				}
+				wake_.notify_all();
+				for(size_t i=0;i<workers_.size();i++)
+					workers_[i].join();
+			}
+			void run()
+			{
+				std::unique_lock<std::mutex> l(lock_);
+				for(;;) {
+					while(queue_.empty() && !stop_) {
+						idle_++;
+						wake_.wait(l);
+						idle_--;
+					}
+					if(queue_.empty())
+						return;
+					std::function<void()> task = std::move(queue_.front());
+					queue_.pop_front();
+					l.unlock();
+					task();
+					task = std::function<void()>();
+					l.lock();
+				}
+			}
+
+			size_t max_threads_;
+			size_t max_queue_;
+			size_t idle_;
+			bool stop_;
+			std::mutex lock_;
+			std::condition_variable wake_;
+			std::deque<std::function<void()> > queue_;
+			std::vector<std::thread> workers_;
+		};
+
+		template<typename T,typename F>
+		std::future<T> run_async(F f)
+		{
+			std::shared_ptr<std::packaged_task<T()> > task(new std::packaged_task<T()>(std::move(f)));
+			std::future<T> res = task->get_future();
+			async_executor::instance().post([task]() { (*task)(); });
+			return res;
+		}
+
+		//
+		// Releases the copy of the statement owned by an asynchronous task before its future becomes ready,
+		// so the last references to the statement and the connection are never released by a worker thread
+		// while the caller already uses the connection again
+		//
+		class release_guard {
+		public:
+			release_guard(statement &st) : st_(st) {}
+			~release_guard()
+			{
+				st_.clear();
+			}
+		private:
+			statement &st_;
+		};
+	}
+
+	// present only for the results of observed queries
+	struct result::data {
+		data(query_event::clock_type::time_point s,int p) : start(s), params(p), rows(0) {}
+		query_event::clock_type::time_point start;
+		int params;
+		unsigned long long rows;
+		std::shared_ptr<std::vector<std::string> const> values;
+	};
 
 	class throw_guard {
 	public:
@@ -43,6 +169,30 @@ namespace cppdb {
 		backend::connection *conn_;
 	};
 
+	namespace {
+		query_event make_event(query_event::event_type type,backend::connection &c,backend::statement *st,int params)
+		{
+			query_event e(type);
+			e.conn = &c;
+			if(st)
+				e.sql = st->sql_query().c_str();
+			e.params = params;
+			e.start = query_event::clock_type::now();
+			return e;
+		}
+		void notify(backend::connection &c,query_event &e)
+		{
+			e.time = query_event::clock_type::now();
+			c.notify(e);
+		}
+		void notify_error(backend::connection &c,query_event &e,char const *msg)
+		{
+			e.type = query_event::error_event;
+			e.error = msg;
+			notify(c,e);
+		}
+	}
+
 	result::result() :
 		eof_(false),
 		fetched_(false),
@@ -55,9 +205,9 @@ namespace cppdb {
 	: eof_(false),
 	  fetched_(false),
 	  current_col_(0),
-	  res_(res),
-	  stat_(stat),
-	  conn_(conn)
+	  res_(std::move(res)),
+	  stat_(std::move(stat)),
+	  conn_(std::move(conn))
 	{
 	}
 	result::result(result const &other) :
@@ -72,6 +222,8 @@ namespace cppdb {
 
 	result const &result::operator=(result const &other)
 	{
+		if(d && this != &other)
+			clear();
 		eof_ = other.eof_;
 		fetched_ = other.fetched_;
 		current_col_ = other.current_col_;
@@ -81,6 +233,38 @@ namespace cppdb {
 		return *this;
 	}
 
+	result::result(result &&other) noexcept :
+		d(std::move(other.d)),
+		eof_(other.eof_),
+		fetched_(other.fetched_),
+		current_col_(other.current_col_),
+		res_(std::move(other.res_)),
+		stat_(std::move(other.stat_)),
+		conn_(std::move(other.conn_))
+	{
+		other.eof_ = true;
+		other.fetched_ = true;
+	}
+
+	result const &result::operator=(result &&other)
+	{
+		if(this != &other) {
+			if(d)
+				clear();
+			d = std::move(other.d);
+			eof_ = other.eof_;
+			fetched_ = other.fetched_;
+			current_col_ = other.current_col_;
+			// release in the same order as clear() does
+			res_ = std::move(other.res_);
+			stat_ = std::move(other.stat_);
+			conn_ = std::move(other.conn_);
+			other.eof_ = true;
+			other.fetched_ = true;
+		}
+		return *this;
+	}
+
 	result::~result()
 	{
 		clear();
@@ -98,19 +282,56 @@ namespace cppdb {
 		if(eof_)
 			return false;
 		fetched_=true;
-		eof_ = res_->next()==false;
 		current_col_ = 0;
+		if(!d) {
+			eof_ = res_->next()==false;
+			return !eof_;
+		}
+		try {
+			eof_ = res_->next()==false;
+		}
+		catch(std::exception const &e) {
+			query_event ev = make_event(query_event::first_row_event,*conn_,stat_.get(),d->params);
+			ev.is_query = true;
+			ev.start = d->start;
+			ev.rows = d->rows;
+			ev.values = d->values.get();
+			notify_error(*conn_,ev,e.what());
+			throw;
+		}
+		if(!eof_ && d->rows++ == 0) {
+			query_event ev = make_event(query_event::first_row_event,*conn_,stat_.get(),d->params);
+			ev.is_query = true;
+			ev.start = d->start;
+			ev.rows = 1;
+			ev.values = d->values.get();
+			notify(*conn_,ev);
+		}
 		return !eof_;
 	}
 	
 	int result::index(std::string const &n)
 	{
-		int c = res_->name_to_column(n);
+		return index(n.c_str());
+	}
+
+	int result::index(char const *n)
+	{
+		int c = find_column(n);
 		if(c<0)
 			throw invalid_column();
 		return c;
 	}
 
+	int result::find_column(char const *n)
+	{
+		if(!stat_) {
+			int c = res_->name_to_column(n);
+			return c < 0 ? -1 : c;
+		}
+		return stat_->find_column(*res_,n);
+	}
+
 	std::string result::name(int col)
 	{
 		if(col < 0 || col>= cols())
@@ -120,10 +341,7 @@ namespace cppdb {
 
 	int result::find_column(std::string const &name)
 	{
-		int c = res_->name_to_column(name);
-		if(c < 0)
-			return -1;
-		return c;
+		return find_column(name.c_str());
 	}
 
 	void result::rewind_column()
@@ -140,6 +358,17 @@ namespace cppdb {
 
 	void result::clear()
 	{
+		if(d) {
+			query_event ev = make_event(query_event::close_event,*conn_,stat_.get(),d->params);
+			ev.is_query = true;
+			ev.start = d->start;
+			ev.rows = d->rows;
+			// keep the values alive till the observers are notified
+			std::shared_ptr<std::vector<std::string> const> values = std::move(d->values);
+			ev.values = values.get();
+			d.reset();
+			notify(*conn_,ev);
+		}
 		eof_ = true;
 		fetched_ = true;
 		res_.reset();
@@ -161,6 +390,10 @@ namespace cppdb {
 	{
 		return is_null(index(n));
 	}
+	bool result::is_null(char const *n)
+	{
+		return is_null(index(n));
+	}
 
 	
 	bool result::fetch(int col,short &v) { return res_->fetch(col,v); }
@@ -193,6 +426,21 @@ namespace cppdb {
 	bool result::fetch(std::string const &n,std::tm &v) { return res_->fetch(index(n),v); }
 	bool result::fetch(std::string const &n,std::ostream &v) { return res_->fetch(index(n),v); }
 
+	bool result::fetch(char const *n,short &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,unsigned short &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,int &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,unsigned &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,long &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,unsigned long &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,long long &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,unsigned long long &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,float &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,double &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,long double &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,std::string &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,std::tm &v) { return res_->fetch(index(n),v); }
+	bool result::fetch(char const *n,std::ostream &v) { return res_->fetch(index(n),v); }
+
 	bool result::fetch(short &v) { return res_->fetch(current_col_++,v); }
 	bool result::fetch(unsigned short &v) { return res_->fetch(current_col_++,v); }
 	bool result::fetch(int &v) { return res_->fetch(current_col_++,v); }
@@ -210,9 +458,109 @@ namespace cppdb {
 
 
 
-	struct statement::data {};
+	// present only for the statements of the connections that capture the bound values
+	struct statement::data {
+		typedef std::vector<std::string> values_type;
+		// shared with the results of the queries, so it is copied on write
+		std::shared_ptr<values_type> values;
+
+		values_type const *get() const
+		{
+			return values.get();
+		}
+		void clear()
+		{
+			if(values && values.use_count() == 1)
+				values->clear();
+			else
+				values.reset();
+		}
+		void set(int col,std::string v)
+		{
+			if(col < 1)
+				return;
+			if(!values)
+				values = std::make_shared<values_type>();
+			else if(values.use_count() > 1)
+				values = std::make_shared<values_type>(*values);
+			if(values->size() < size_t(col))
+				values->resize(col,"?");
+			(*values)[col - 1] = std::move(v);
+		}
+
+		template<typename Integer>
+		void capture(int col,Integer v)
+		{
+			set(col,std::to_string(v));
+		}
+		void capture(int col,double v)
+		{
+			char buf[64];
+			snprintf(buf,sizeof(buf),"%.17g",v);
+			set(col,buf);
+		}
+		void capture(int col,long double v)
+		{
+			char buf[64];
+			snprintf(buf,sizeof(buf),"%.21Lg",v);
+			set(col,buf);
+		}
+		void capture(int col,char const *b,char const *e)
+		{
+			size_t const max_text = 256;
+			bool cut = size_t(e - b) > max_text;
+			if(cut)
+				e = b + max_text;
+			std::string v;
+			v.reserve(e - b + 5);
+			v += '\'';
+			for(;b!=e;++b) {
+				if(*b == '\'')
+					v += '\'';
+				v += *b;
+			}
+			v += '\'';
+			if(cut)
+				v += "...";
+			set(col,std::move(v));
+		}
+		void capture(int col,std::string const &v)
+		{
+			capture(col,v.c_str(),v.c_str() + v.size());
+		}
+		void capture(int col,char const *v)
+		{
+			capture(col,v,v + strlen(v));
+		}
+		void capture(int col,std::tm const &v)
+		{
+			capture(col,format_time(v));
+		}
+		void capture(int col,std::istream &)
+		{
+			set(col,"<blob>");
+		}
+		void capture_null(int col)
+		{
+			set(col,"NULL");
+		}
+		void capture(int first_col,params const &vals)
+		{
+			for(size_t i=0;i<vals.size();i++) {
+				int col = first_col + int(i);
+				switch(vals.type(i)) {
+				case params::null_type: capture_null(col); break;
+				case params::int_type: capture(col,vals.as_int(i)); break;
+				case params::uint_type: capture(col,vals.as_uint(i)); break;
+				case params::real_type: capture(col,vals.as_real(i)); break;
+				case params::text_type: capture(col,vals.as_text(i)); break;
+				case params::time_type: capture(col,vals.as_time(i)); break;
+				}
+			}
+		}
+	};
 
-	statement::statement() : placeholder_(1) {}
+	statement::statement() : placeholder_(1), max_col_(0) {}
 	statement::~statement()
 	{
 		stat_.reset();
@@ -221,23 +569,55 @@ namespace cppdb {
 
 	statement::statement(statement const &other) :
 		placeholder_(other.placeholder_),
+		max_col_(other.max_col_),
 		stat_(other.stat_),
-		conn_(other.conn_)
+		conn_(other.conn_),
+		d(other.d ? new data(*other.d) : 0)
 	{
 	}
 	statement const &statement::operator=(statement const &other)
 	{
-		placeholder_ = other.placeholder_;
-		stat_=other.stat_;
-		conn_=other.conn_;
+		if(this != &other) {
+			placeholder_ = other.placeholder_;
+			max_col_ = other.max_col_;
+			stat_=other.stat_;
+			conn_=other.conn_;
+			d.reset(other.d ? new data(*other.d) : 0);
+		}
+		return *this;
+	}
+	statement::statement(statement &&other) noexcept :
+		placeholder_(other.placeholder_),
+		max_col_(other.max_col_),
+		stat_(std::move(other.stat_)),
+		conn_(std::move(other.conn_)),
+		d(std::move(other.d))
+	{
+		other.placeholder_ = 1;
+		other.max_col_ = 0;
+	}
+	statement const &statement::operator=(statement &&other)
+	{
+		if(this != &other) {
+			placeholder_ = other.placeholder_;
+			max_col_ = other.max_col_;
+			stat_ = std::move(other.stat_);
+			conn_ = std::move(other.conn_);
+			d = std::move(other.d);
+			other.placeholder_ = 1;
+			other.max_col_ = 0;
+		}
 		return *this;
 	}
 
 	statement::statement(ref_ptr<backend::statement> stat,ref_ptr<backend::connection> conn) :
 		placeholder_(1),
-		stat_(stat),
-		conn_(conn)
+		max_col_(0),
+		stat_(std::move(stat)),
+		conn_(std::move(conn))
 	{
+		if(conn_ && conn_->capture_params())
+			d.reset(new data());
 	}
 
 	bool statement::empty() const
@@ -249,12 +629,16 @@ namespace cppdb {
 	{
 		stat_.reset();
 		conn_.reset();
+		d.reset();
 	}
 
 	void statement::reset()
 	{
 		throw_guard g(conn_);
 		placeholder_ = 1;
+		max_col_ = 0;
+		if(d)
+			d->clear();
 		stat_->reset();
 	}
 
@@ -276,6 +660,10 @@ namespace cppdb {
 	{
 		return bind(v);
 	}
+	statement &statement::operator<<(params const &values)
+	{
+		return bind(values);
+	}
 
 	statement &statement::operator<<(void (*manipulator)(statement &st))
 	{
@@ -289,134 +677,222 @@ namespace cppdb {
 
 	statement &statement::bind(int v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(unsigned v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(long v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(unsigned long v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(long long v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(unsigned long long v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(double v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(long double v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 
 	statement &statement::bind(std::string const &v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(char const *s)
 	{
+		if(d)
+			d->capture(placeholder_,s);
 		stat_->bind(placeholder_++,s);
 		return *this;
 	}
 	statement &statement::bind(char const *b,char const *e)
 	{
+		if(d)
+			d->capture(placeholder_,b,e);
 		stat_->bind(placeholder_++,b,e);
 		return *this;
 	}
 	statement &statement::bind(std::tm const &v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind(std::istream &v)
 	{
+		if(d)
+			d->capture(placeholder_,v);
 		stat_->bind(placeholder_++,v);
 		return *this;
 	}
 	statement &statement::bind_null()
 	{
+		if(d)
+			d->capture_null(placeholder_);
 		stat_->bind_null(placeholder_++);
 		return *this;
 	}
+	statement &statement::bind(params const &values)
+	{
+		if(d)
+			d->capture(placeholder_,values);
+		stat_->bind_params(placeholder_,values);
+		placeholder_ += values.size();
+		return *this;
+	}
 
 
 	void statement::bind(int col,std::string const &v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,char const *s)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,s);
 		stat_->bind(col,s);
 	}
 	void statement::bind(int col,char const *b,char const *e)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,b,e);
 		stat_->bind(col,b,e);
 	}
 	void statement::bind(int col,std::tm const &v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,std::istream &v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,int v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,unsigned v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,long v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,unsigned long v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,long long v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,unsigned long long v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,double v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind(int col,long double v)
 	{
+		bound(col);
+		if(d)
+			d->capture(col,v);
 		stat_->bind(col,v);
 	}
 	void statement::bind_null(int col)
 	{
+		bound(col);
+		if(d)
+			d->capture_null(col);
 		stat_->bind_null(col);
 	}
 
+	void statement::bound(int col)
+	{
+		if(col > max_col_)
+			max_col_ = col;
+	}
+	int statement::bound_params() const
+	{
+		return placeholder_ - 1 > max_col_ ? placeholder_ - 1 : max_col_;
+	}
+
 	long long statement::last_insert_id()
 	{
 		throw_guard g(conn_);
@@ -437,8 +913,7 @@ namespace cppdb {
 	result statement::row()
 	{
 		throw_guard g(conn_);
-		ref_ptr<backend::result> backend_res = stat_->query();
-		result res(backend_res,stat_,conn_);
+		result res = query();
 		if(res.next()) {
 			if(res.res_->has_next() == backend::result::next_row_exists) {
 				g.done();
@@ -451,8 +926,28 @@ namespace cppdb {
 	result statement::query()
 	{
 		throw_guard g(conn_);
-		ref_ptr<backend::result> res(stat_->query());
-		return result(res,stat_,conn_);
+		if(!conn_->observed()) {
+			ref_ptr<backend::result> res(stat_->query());
+			return result(std::move(res),stat_,conn_);
+		}
+		query_event e = make_event(query_event::execute_event,*conn_,stat_.get(),bound_params());
+		e.is_query = true;
+		if(d)
+			e.values = d->get();
+		ref_ptr<backend::result> backend_res;
+		try {
+			backend_res = stat_->query();
+		}
+		catch(std::exception const &err) {
+			notify_error(*conn_,e,err.what());
+			throw;
+		}
+		notify(*conn_,e);
+		result res(std::move(backend_res),stat_,conn_);
+		res.d.reset(new result::data(e.start,e.params));
+		if(d)
+			res.d->values = d->values;
+		return res;
 	}
 	statement::operator result()
 	{
@@ -461,7 +956,64 @@ namespace cppdb {
 	void statement::exec() 
 	{
 		throw_guard g(conn_);
-		stat_->exec();
+		if(!conn_->observed()) {
+			stat_->exec();
+			return;
+		}
+		query_event e = make_event(query_event::execute_event,*conn_,stat_.get(),bound_params());
+		if(d)
+			e.values = d->get();
+		try {
+			stat_->exec();
+			e.affected = stat_->affected();
+		}
+		catch(std::exception const &err) {
+			notify_error(*conn_,e,err.what());
+			throw;
+		}
+		notify(*conn_,e);
+	}
+
+	std::future<result> statement::query_async()
+	{
+		throw_guard g(conn_);
+		statement self(*this);
+		auto task = [self]() mutable {
+			release_guard guard(self);
+			return self.query();
+		};
+		if(stat_->send_async())
+			return std::async(std::launch::deferred,std::move(task));
+		return run_async<result>(std::move(task));
+	}
+
+	std::future<unsigned long long> statement::exec_async()
+	{
+		throw_guard g(conn_);
+		statement self(*this);
+		auto task = [self]() mutable {
+			release_guard guard(self);
+			self.exec();
+			return self.affected();
+		};
+		if(stat_->send_async())
+			return std::async(std::launch::deferred,std::move(task));
+		return run_async<unsigned long long>(std::move(task));
+	}
+
+	bool statement::send_async()
+	{
+		throw_guard g(conn_);
+		return stat_->send_async();
+	}
+	bool statement::async_ready()
+	{
+		throw_guard g(conn_);
+		return stat_->async_ready();
+	}
+	int statement::async_socket()
+	{
+		return stat_->async_socket();
 	}
 
 	struct session::data {};
@@ -478,10 +1030,19 @@ namespace cppdb {
 		conn_ = other.conn_;
 		return *this;
 	}
-	session::session(ref_ptr<backend::connection> conn) : conn_(conn)
+	session::session(session &&other) noexcept :
+		conn_(std::move(other.conn_))
+	{
+	}
+	session const &session::operator=(session &&other)
+	{
+		conn_ = std::move(other.conn_);
+		return *this;
+	}
+	session::session(ref_ptr<backend::connection> conn) : conn_(std::move(conn))
 	{
 	}
-	session::session(ref_ptr<backend::connection> conn,once_functor const &f) : conn_(conn)
+	session::session(ref_ptr<backend::connection> conn,once_functor const &f) : conn_(std::move(conn))
 	{
 		once(f);
 	}
@@ -515,6 +1076,26 @@ namespace cppdb {
 	{
 		conn_ = connections_manager::instance().open(cs);
 	}
+	void session::open(connection_info const &ci,std::string const &affinity)
+	{
+		conn_ = connections_manager::instance().open(ci,affinity);
+	}
+	void session::open(std::string const &cs,std::string const &affinity)
+	{
+		conn_ = connections_manager::instance().open(cs,affinity);
+	}
+	void session::open_writer(connection_info const &ci)
+	{
+		// the session may hold the writer already
+		conn_.reset();
+		conn_ = connections_manager::instance().open_writer(ci);
+	}
+	void session::open_writer(std::string const &cs)
+	{
+		// the session may hold the writer already
+		conn_.reset();
+		conn_ = connections_manager::instance().open_writer(cs);
+	}
 	void session::close()
 	{
 		conn_.reset();
@@ -529,7 +1110,15 @@ namespace cppdb {
 	{
 		throw_guard g(conn_);
 		ref_ptr<backend::statement> stat_ptr(conn_->prepare(query));
-		statement stat(stat_ptr,conn_);
+		statement stat(std::move(stat_ptr),conn_);
+		return stat;
+	}
+	
+	statement session::prepare(char const *query)
+	{
+		throw_guard g(conn_);
+		ref_ptr<backend::statement> stat_ptr(conn_->prepare(query));
+		statement stat(std::move(stat_ptr),conn_);
 		return stat;
 	}
 	
@@ -537,7 +1126,7 @@ namespace cppdb {
 	{
 		throw_guard g(conn_);
 		ref_ptr<backend::statement> stat_ptr(conn_->get_statement(query));
-		statement stat(stat_ptr,conn_);
+		statement stat(std::move(stat_ptr),conn_);
 		return stat;
 	}
 	
@@ -545,7 +1134,7 @@ namespace cppdb {
 	{
 		throw_guard g(conn_);
 		ref_ptr<backend::statement> stat_ptr(conn_->get_prepared_statement(query));
-		statement stat(stat_ptr,conn_);
+		statement stat(std::move(stat_ptr),conn_);
 		return stat;
 	}
 	
@@ -553,11 +1142,74 @@ namespace cppdb {
 	{
 		throw_guard g(conn_);
 		ref_ptr<backend::statement> stat_ptr(conn_->get_prepared_uncached_statement(query));
-		statement stat(stat_ptr,conn_);
+		statement stat(std::move(stat_ptr),conn_);
 		return stat;
 	}
 
 
+	void session::blob_read(std::string const &table,std::string const &column,long long rowid,std::ostream &out)
+	{
+		throw_guard g(conn_);
+		conn_->blob_read(table,column,rowid,out);
+	}
+	void session::blob_write(std::string const &table,std::string const &column,long long rowid,std::istream &in)
+	{
+		throw_guard g(conn_);
+		conn_->blob_write(table,column,rowid,in);
+	}
+
+	namespace {
+		// the returning clause is appended to the query, so a trailing ';' and white space must go
+		std::string strip_statement_end(std::string const &q)
+		{
+			size_t end = q.size();
+			while(end > 0 && (isspace(static_cast<unsigned char>(q[end-1])) || q[end-1]==';'))
+				end--;
+			return q.substr(0,end);
+		}
+	}
+
+	long long session::insert_returning_id(std::string const &q,std::string const &id_column,params const &values,std::string const &sequence)
+	{
+		throw_guard g(conn_);
+		long long id = 0;
+		std::string rq = conn_->returning_query(strip_statement_end(q),id_column);
+		// use the frontend objects so the observers see the query
+		if(!rq.empty()) {
+			result res = prepare(rq).bind(values).query();
+			if(!res.next() || !res.fetch(0,id))
+				throw cppdb_error("cppdb::insert_returning_id: no id returned");
+		}
+		else {
+			statement st = prepare(q);
+			st.bind(values);
+			st.exec();
+			id = st.sequence_last(sequence);
+		}
+		g.done();
+		return id;
+	}
+
+	unsigned long long session::bulk_load(std::string const &table,std::vector<std::string> const &columns,bulk_source &source)
+	{
+		throw_guard g(conn_);
+		return conn_->bulk_load(table,columns,source);
+	}
+
+	namespace {
+		struct function_source : public bulk_source {
+			function_source(std::function<bool(params &)> const &f) : next_row(f) {}
+			virtual bool next(params &row) { return next_row(row); }
+			std::function<bool(params &)> const &next_row;
+		};
+	}
+
+	unsigned long long session::bulk_load(std::string const &table,std::vector<std::string> const &columns,std::function<bool(params &)> const &next_row)
+	{
+		function_source source(next_row);
+		return bulk_load(table,columns,source);
+	}
+
 	statement session::operator<<(std::string const &q)
 	{
 		return prepare(q);
@@ -670,6 +1322,19 @@ namespace cppdb {
 		conn_->recyclable(v);
 	}
 
+	void session::add_observer(std::shared_ptr<query_observer> const &o)
+	{
+		conn_->add_observer(o);
+	}
+	void session::remove_observer(query_observer *o)
+	{
+		conn_->remove_observer(o);
+	}
+	statement_cache_stats session::cache_stats()
+	{
+		return conn_->cache_stats();
+	}
+
 	connection_specific_data *session::get_specific(std::type_info const &t)
 	{
 		return conn_->connection_specific_get(t);
@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#define CPPDB_SOURCE
+#include <cppdb/params.h>
+#include <cppdb/errors.h>
+#include <string.h>
+
+namespace cppdb {
+
+	struct params::data {};
+
+	params::params() : size_(0)
+	{
+	}
+	params::~params()
+	{
+	}
+	params::params(params const &other) :
+		values_(other.values_.begin(),other.values_.begin() + other.size_),
+		size_(other.size_)
+	{
+	}
+	params const &params::operator=(params const &other)
+	{
+		if(this != &other) {
+			clear();
+			values_.reserve(other.size_);
+			for(size_t i=0;i<other.size_;i++)
+				next() = other.values_[i];
+		}
+		return *this;
+	}
+	params::params(params &&other) noexcept :
+		values_(std::move(other.values_)),
+		size_(other.size_)
+	{
+		other.size_ = 0;
+	}
+	params const &params::operator=(params &&other)
+	{
+		values_.swap(other.values_);
+		size_ = other.size_;
+		other.clear();
+		return *this;
+	}
+
+	size_t params::size() const
+	{
+		return size_;
+	}
+	bool params::empty() const
+	{
+		return size_ == 0;
+	}
+	void params::clear()
+	{
+		size_ = 0;
+	}
+
+	params::value &params::next()
+	{
+		if(size_ == values_.size())
+			values_.push_back(value());
+		return values_[size_++];
+	}
+	params::value const &params::at(size_t i) const
+	{
+		if(i >= size_)
+			throw cppdb_error("cppdb::params: index out of range");
+		return values_[i];
+	}
+
+	params &params::add_null()
+	{
+		next().type = null_type;
+		return *this;
+	}
+	params &params::add(long long v)
+	{
+		value &val = next();
+		val.type = int_type;
+		val.number.i = v;
+		return *this;
+	}
+	params &params::add(unsigned long long v)
+	{
+		value &val = next();
+		val.type = uint_type;
+		val.number.u = v;
+		return *this;
+	}
+	params &params::add(double v)
+	{
+		value &val = next();
+		val.type = real_type;
+		val.number.r = v;
+		return *this;
+	}
+	params &params::add(std::string const &v)
+	{
+		return add(v.c_str(),v.c_str()+v.size());
+	}
+	params &params::add(char const *v)
+	{
+		return add(v,v+strlen(v));
+	}
+	params &params::add(char const *b,char const *e)
+	{
+		value &val = next();
+		val.type = text_type;
+		val.text.assign(b,e);
+		return *this;
+	}
+	params &params::add(std::tm const &v)
+	{
+		value &val = next();
+		val.type = time_type;
+		val.time = v;
+		return *this;
+	}
+
+	params::value_type params::type(size_t i) const
+	{
+		return at(i).type;
+	}
+	long long params::as_int(size_t i) const
+	{
+		return at(i).number.i;
+	}
+	unsigned long long params::as_uint(size_t i) const
+	{
+		return at(i).number.u;
+	}
+	double params::as_real(size_t i) const
+	{
+		return at(i).number.r;
+	}
+	std::string const &params::as_text(size_t i) const
+	{
+		return at(i).text;
+	}
+	std::tm const &params::as_time(size_t i) const
+	{
+		return at(i).time;
+	}
+
+}
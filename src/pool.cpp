@@ -20,12 +20,70 @@
 #include <cppdb/backend.h>
 #include <cppdb/utils.h>
 #include <cppdb/driver_manager.h>
+#include <cppdb/stats.h>
 
 #include <stdlib.h>
+#include <map>
+#include <vector>
+#include <condition_variable>
 
 namespace cppdb {
 
-	struct pool::data {};
+	struct pool::data {
+		data() : 
+			hot_limit(0),
+			single_writer(false),
+			writer_out(0),
+			writer_opened(false),
+			next_ticket(0),
+			serving(0),
+			hits(0),
+			misses(0),
+			creates(0),
+			destroys(0),
+			evictions(0),
+			busy(0)
+		{
+		}
+		// non-mutable
+		size_t hot_limit;
+		bool single_writer;
+		connection_info reader_ci;
+		connection_info writer_ci;
+		// protected by lock_, most recently prepared first
+		typedef std::list<std::string> hot_type;
+		hot_type hot;
+		std::map<std::string,hot_type::iterator> hot_index;
+		// protected by lock_, the writer is either idle or owned by the caller being served
+		ref_ptr<backend::connection> writer;
+		backend::connection *writer_out;
+		bool writer_opened;
+		unsigned long long next_ticket;
+		unsigned long long serving;
+		std::condition_variable writer_cv;
+		// counters, protected by lock_
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long creates;
+		unsigned long long destroys;
+		unsigned long long evictions;
+		size_t busy;
+		statement_cache_stats statements;
+		// lock free
+		latency_histogram checkout;
+
+		// called with lock_ held
+		void returned(backend::connection *c)
+		{
+			busy--;
+			statement_cache_stats s = c->collect_cache_stats();
+			statements.hits += s.hits;
+			statements.misses += s.misses;
+			statements.evictions += s.evictions;
+			statements.reprepares += s.reprepares;
+			statements.capacity = s.capacity;
+		}
+	};
 
 	ref_ptr<pool> pool::create(connection_info const &ci)
 	{
@@ -40,6 +98,7 @@ namespace cppdb {
 	}
 
 	pool::pool(connection_info const &ci) :
+		d(new data()),
 		limit_(0),
 		life_time_(0),
 		ci_(ci),
@@ -47,6 +106,23 @@ namespace cppdb {
 	{
 		limit_ = ci_.get("@pool_size",16);
 		life_time_ = ci_.get("@pool_max_idle",600);
+		int hot = ci_.get("@pool_warmup",0);
+		if(hot > 0)
+			d->hot_limit = hot;
+		std::string mode = ci_.get("@pool_mode","default");
+		if(mode == "single_writer") {
+			d->single_writer = true;
+			d->reader_ci = ci_;
+			d->writer_ci = ci_;
+			if(ci_.driver == "sqlite3") {
+				d->reader_ci.properties["mode"] = "readonly";
+				if(!ci_.has("journal_mode"))
+					d->writer_ci.properties["journal_mode"] = "wal";
+			}
+		}
+		else if(mode != "default") {
+			throw cppdb_error("cppdb::pool: invalid @pool_mode, expected 'default' or 'single_writer'");
+		}
 	}
 		
 	pool::~pool()
@@ -55,20 +131,188 @@ namespace cppdb {
 
 	ref_ptr<backend::connection> pool::open()
 	{
+		return open(std::string());
+	}
+
+	ref_ptr<backend::connection> pool::open(std::string const &affinity)
+	{
+		connection_info const &ci = d->single_writer ? d->reader_ci : ci_;
+		if(d->single_writer) {
+			bool opened;
+			{
+				std::lock_guard<std::mutex> l(lock_);
+				opened = d->writer_opened;
+			}
+			// the writer sets up the database (journal mode) for the readers
+			if(!opened)
+				setup_writer();
+		}
+
+		// not pooled and not counted
 		if(limit_ == 0)
-			return driver_manager::instance().connect(ci_);
+			return driver_manager::instance().connect(ci);
 
-		ref_ptr<backend::connection> p = get();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		// counted as busy and, if missing, as created by get()
+		ref_ptr<backend::connection> p = get(affinity);
 
 		if(!p) {
-			p=driver_manager::instance().connect(ci_);
+			try {
+				p=driver_manager::instance().connect(ci);
+				warm_up(*p);
+			}
+			catch(...) {
+				std::lock_guard<std::mutex> l(lock_);
+				d->creates--;
+				d->busy--;
+				throw;
+			}
 		}
+		if(!affinity.empty())
+			p->affinity(affinity);
 		p->set_pool(this);
+		d->checkout.record(std::chrono::steady_clock::now() - start);
 		return p;
 	}
 
 	// this is thread safe member function
-	ref_ptr<backend::connection> pool::get()
+	ref_ptr<backend::connection> pool::open_writer()
+	{
+		if(!d->single_writer)
+			return open();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ref_ptr<backend::connection> w;
+		{
+			std::unique_lock<std::mutex> l(lock_);
+			unsigned long long ticket = d->next_ticket++;
+			while(d->serving != ticket)
+				d->writer_cv.wait(l);
+			w.swap(d->writer);
+			if(w)
+				d->hits++;
+			else
+				d->misses++;
+		}
+		bool created = false;
+		try {
+			if(!w) {
+				w = driver_manager::instance().connect(d->writer_ci);
+				warm_up(*w);
+				created = true;
+			}
+		}
+		catch(...) {
+			std::lock_guard<std::mutex> l(lock_);
+			d->serving++;
+			d->writer_cv.notify_all();
+			throw;
+		}
+		{
+			std::lock_guard<std::mutex> l(lock_);
+			d->writer_out = w.get();
+			d->writer_opened = true;
+			d->busy++;
+			if(created)
+				d->creates++;
+		}
+		w->set_pool(this);
+		d->checkout.record(std::chrono::steady_clock::now() - start);
+		return w;
+	}
+
+	// opens the writer and keeps it idle, it is not a checkout so only its creation is counted
+	void pool::setup_writer()
+	{
+		{
+			std::unique_lock<std::mutex> l(lock_);
+			unsigned long long ticket = d->next_ticket++;
+			while(d->serving != ticket)
+				d->writer_cv.wait(l);
+			if(d->writer_opened) {
+				d->serving++;
+				d->writer_cv.notify_all();
+				return;
+			}
+		}
+		ref_ptr<backend::connection> w;
+		try {
+			w = driver_manager::instance().connect(d->writer_ci);
+			warm_up(*w);
+		}
+		catch(...) {
+			std::lock_guard<std::mutex> l(lock_);
+			d->serving++;
+			d->writer_cv.notify_all();
+			throw;
+		}
+		std::lock_guard<std::mutex> l(lock_);
+		d->writer.swap(w);
+		d->writer_opened = true;
+		d->creates++;
+		d->serving++;
+		d->writer_cv.notify_all();
+	}
+
+	// returns true if c is the writer, passes it to the next caller waiting for it,
+	// called with lock_ held
+	bool pool::put_writer(backend::connection *c)
+	{
+		if(!d->single_writer || !c)
+			return false;
+		if(c != d->writer_out)
+			return false;
+		if(c->recyclable())
+			d->writer = c;
+		d->writer_out = 0;
+		d->serving++;
+		d->writer_cv.notify_all();
+		return true;
+	}
+
+	// this is thread safe member function
+	void pool::discard(backend::connection *c)
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		put_writer(c);
+		d->returned(c);
+		d->destroys++;
+	}
+
+	// this is thread safe member function
+	void pool::statement_prepared(std::string const &q)
+	{
+		if(d->hot_limit == 0)
+			return;
+		std::lock_guard<std::mutex> l(lock_);
+		std::map<std::string,data::hot_type::iterator>::iterator p = d->hot_index.find(q);
+		if(p!=d->hot_index.end()) {
+			d->hot.splice(d->hot.begin(),d->hot,p->second);
+			return;
+		}
+		d->hot.push_front(q);
+		d->hot_index[q]=d->hot.begin();
+		if(d->hot.size() > d->hot_limit) {
+			d->hot_index.erase(d->hot.back());
+			d->hot.pop_back();
+		}
+	}
+
+	void pool::warm_up(backend::connection &c)
+	{
+		if(d->hot_limit == 0)
+			return;
+		std::vector<std::string> queries;
+		{
+			std::lock_guard<std::mutex> l(lock_);
+			// least recent first, so the hottest ones end up most recent in cache
+			queries.assign(d->hot.rbegin(),d->hot.rend());
+		}
+		c.warm_up(queries);
+	}
+
+	// this is thread safe member function
+	ref_ptr<backend::connection> pool::get(std::string const &affinity)
 	{
 		if(limit_ == 0)
 			return 0;
@@ -85,6 +329,8 @@ namespace cppdb {
 					p++;
 					garbage.splice(garbage.begin(),pool_,tmp);
 					size_ --;
+					d->evictions++;
+					d->destroys++;
 				}
 				else {
 					// all is sorted by time
@@ -92,10 +338,28 @@ namespace cppdb {
 				}
 			}
 			if(!pool_.empty()) {
-				c = pool_.back().conn;
-				pool_.pop_back();
+				pool_type::iterator selected = --pool_.end();
+				if(!affinity.empty()) {
+					// the most recently used connection with same tag
+					for(pool_type::iterator tmp = pool_.end();tmp!=pool_.begin();) {
+						--tmp;
+						if(tmp->conn->affinity() == affinity) {
+							selected = tmp;
+							break;
+						}
+					}
+				}
+				c = selected->conn;
+				pool_.erase(selected);
 				size_ --;
+				d->hits++;
 			}
+			else {
+				// the caller opens a new one
+				d->misses++;
+				d->creates++;
+			}
+			d->busy++;
 		}
 		return c;
 	}
@@ -103,13 +367,23 @@ namespace cppdb {
 	// this is thread safe member function
 	void pool::put(backend::connection *c_in)
 	{
-		std::unique_ptr<backend::connection> c(c_in);
-		if(limit_ == 0)
-			return;
+		// declared before the lock, so destroyed after it is released
+		std::unique_ptr<backend::connection> c;
 		pool_type garbage;
 		std::time_t now = time(0);
 		{
 			std::lock_guard<std::mutex> l(lock_);
+			if(c_in) {
+				d->returned(c_in);
+				if(put_writer(c_in))
+					return;
+				c.reset(c_in);
+			}
+			if(limit_ == 0) {
+				if(c)
+					d->destroys++;
+				return;
+			}
 			// under lock do all very fast
 			if(c.get()) {
 				pool_.push_back(entry());
@@ -127,6 +401,8 @@ namespace cppdb {
 					p++;
 					garbage.splice(garbage.begin(),pool_,tmp);
 					size_ --;
+					d->evictions++;
+					d->destroys++;
 				}
 				else {
 					// all is sorted by time
@@ -137,6 +413,7 @@ namespace cppdb {
 			if(size_ > limit_) {
 				garbage.splice(garbage.begin(),pool_,pool_.begin());
 				size_--;
+				d->destroys++;
 			}
 		}
 	}
@@ -149,12 +426,41 @@ namespace cppdb {
 	void pool::clear()
 	{
 		pool_type garbage;
+		ref_ptr<backend::connection> writer;
 		{
 			std::lock_guard<std::mutex> l(lock_);
 			garbage.swap(pool_);
 			size_ = 0;
+			writer.swap(d->writer);
+			d->destroys += garbage.size() + (writer ? 1 : 0);
 		} // destroy outside mutex scope
 	}
+
+	pool_stats pool::stats()
+	{
+		pool_stats s;
+		{
+			std::lock_guard<std::mutex> l(lock_);
+			s.hits = d->hits;
+			s.misses = d->misses;
+			s.creates = d->creates;
+			s.destroys = d->destroys;
+			s.evictions = d->evictions;
+			s.idle = size_ + (d->writer ? 1 : 0);
+			s.busy = d->busy;
+			s.statements = d->statements;
+			s.statements.size = 0;
+			for(pool_type::iterator p=pool_.begin();p!=pool_.end();++p)
+				s.statements.size += p->conn->cache_stats().size;
+			if(d->writer)
+				s.statements.size += d->writer->cache_stats().size;
+		}
+		s.checkouts = d->checkout.count();
+		s.checkout_p50 = d->checkout.percentile(50);
+		s.checkout_p99 = d->checkout.percentile(99);
+		s.checkout_max = d->checkout.max_value();
+		return s;
+	}
 }
 
 
@@ -0,0 +1,550 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#define CPPDB_SOURCE
+#include <cppdb/stats.h>
+#include <cppdb/observer.h>
+#include <cppdb/backend.h>
+
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+namespace cppdb {
+
+	namespace {
+		int most_significant_bit(unsigned long long v)
+		{
+			int r = 0;
+			if(v >= (1ULL << 32)) { v >>= 32; r += 32; }
+			if(v >= (1ULL << 16)) { v >>= 16; r += 16; }
+			if(v >= (1ULL << 8)) { v >>= 8; r += 8; }
+			if(v >= (1ULL << 4)) { v >>= 4; r += 4; }
+			if(v >= (1ULL << 2)) { v >>= 2; r += 2; }
+			if(v >= (1ULL << 1)) { r += 1; }
+			return r;
+		}
+	}
+
+	latency_histogram::latency_histogram()
+	{
+		reset();
+	}
+
+	int latency_histogram::bucket(unsigned long long v)
+	{
+		if(v < 32)
+			return int(v);
+		int msb = most_significant_bit(v);
+		int index = (msb - 3) * 16 + int(v >> (msb - 4)) - 16;
+		return index < buckets ? index : buckets - 1;
+	}
+
+	unsigned long long latency_histogram::bucket_lower_bound(int index)
+	{
+		if(index < 32)
+			return index;
+		unsigned long long mantissa = 16 + index % 16;
+		return mantissa << (index / 16 - 1);
+	}
+
+	void latency_histogram::record(std::chrono::nanoseconds d)
+	{
+		unsigned long long v = d.count() > 0 ? d.count() : 0;
+		counts_[bucket(v)].fetch_add(1,std::memory_order_relaxed);
+		count_.fetch_add(1,std::memory_order_relaxed);
+		total_.fetch_add(v,std::memory_order_relaxed);
+		unsigned long long prev = max_.load(std::memory_order_relaxed);
+		while(prev < v && !max_.compare_exchange_weak(prev,v,std::memory_order_relaxed))
+			;
+	}
+
+	unsigned long long latency_histogram::count() const
+	{
+		return count_.load(std::memory_order_relaxed);
+	}
+
+	std::chrono::nanoseconds latency_histogram::total() const
+	{
+		return std::chrono::nanoseconds(total_.load(std::memory_order_relaxed));
+	}
+
+	std::chrono::nanoseconds latency_histogram::max_value() const
+	{
+		return std::chrono::nanoseconds(max_.load(std::memory_order_relaxed));
+	}
+
+	std::chrono::nanoseconds latency_histogram::percentile(double p) const
+	{
+		unsigned long long counts[buckets];
+		unsigned long long n = 0;
+		for(int i=0;i<buckets;i++) {
+			counts[i] = counts_[i].load(std::memory_order_relaxed);
+			n += counts[i];
+		}
+		if(n == 0)
+			return std::chrono::nanoseconds(0);
+		unsigned long long target = (unsigned long long)(n * (p / 100.0) + 0.5);
+		if(target < 1)
+			target = 1;
+		if(target > n)
+			target = n;
+		unsigned long long seen = 0;
+		int i = 0;
+		for(;i<buckets;i++) {
+			seen += counts[i];
+			if(seen >= target)
+				break;
+		}
+		if(i >= buckets)
+			i = buckets - 1;
+		unsigned long long lower = bucket_lower_bound(i);
+		unsigned long long value = lower;
+		if(i < buckets - 1)
+			value += (bucket_lower_bound(i + 1) - lower) / 2;
+		unsigned long long top = max_.load(std::memory_order_relaxed);
+		if(value > top)
+			value = top;
+		return std::chrono::nanoseconds(value);
+	}
+
+	void latency_histogram::reset()
+	{
+		for(int i=0;i<buckets;i++)
+			counts_[i].store(0,std::memory_order_relaxed);
+		count_.store(0,std::memory_order_relaxed);
+		total_.store(0,std::memory_order_relaxed);
+		max_.store(0,std::memory_order_relaxed);
+	}
+
+	namespace stats {
+		namespace {
+			struct entry {
+				entry(std::string const &q) : query(q), executions(0), rows(0), errors(0) {}
+				std::string query;
+				std::atomic<unsigned long long> executions;
+				std::atomic<unsigned long long> rows;
+				std::atomic<unsigned long long> errors;
+				latency_histogram latency;
+			};
+
+			// the entries are never removed so the pointers to them remain valid
+			class registry {
+			public:
+				static registry &instance()
+				{
+					static registry inst;
+					return inst;
+				}
+				entry *get(std::string const &shape)
+				{
+					std::lock_guard<std::mutex> l(lock_);
+					entries_type::iterator p = entries_.find(shape);
+					if(p != entries_.end())
+						return p->second.get();
+					if(entries_.size() >= max_shapes) {
+						// protect from the queries that can't be normalized, like ones with inlined identifiers
+						std::unique_ptr<entry> &other = entries_["<other>"];
+						if(!other)
+							other.reset(new entry("<other>"));
+						return other.get();
+					}
+					std::unique_ptr<entry> &e = entries_[shape];
+					e.reset(new entry(shape));
+					return e.get();
+				}
+				std::vector<query_stats> snapshot()
+				{
+					std::vector<query_stats> res;
+					std::lock_guard<std::mutex> l(lock_);
+					res.reserve(entries_.size());
+					for(entries_type::const_iterator p=entries_.begin();p!=entries_.end();++p) {
+						entry const &e = *p->second;
+						query_stats s;
+						s.query = e.query;
+						s.executions = e.executions.load(std::memory_order_relaxed);
+						s.rows = e.rows.load(std::memory_order_relaxed);
+						s.errors = e.errors.load(std::memory_order_relaxed);
+						s.total = e.latency.total();
+						s.p50 = e.latency.percentile(50);
+						s.p99 = e.latency.percentile(99);
+						s.p999 = e.latency.percentile(99.9);
+						s.max = e.latency.max_value();
+						res.push_back(s);
+					}
+					return res;
+				}
+				void reset()
+				{
+					std::lock_guard<std::mutex> l(lock_);
+					for(entries_type::iterator p=entries_.begin();p!=entries_.end();++p) {
+						entry &e = *p->second;
+						e.executions.store(0,std::memory_order_relaxed);
+						e.rows.store(0,std::memory_order_relaxed);
+						e.errors.store(0,std::memory_order_relaxed);
+						e.latency.reset();
+					}
+				}
+			private:
+				static size_t const max_shapes = 10000;
+				typedef std::map<std::string,std::unique_ptr<entry> > entries_type;
+				std::mutex lock_;
+				entries_type entries_;
+			};
+
+			//
+			// Per thread cache of the entries by the address of the query text, the statements
+			// keep their text during their lifetime, so the text is compared only to detect a reuse
+			// of the address by another statement.
+			//
+			class thread_cache {
+			public:
+				entry *get(char const *sql)
+				{
+					slot &s = slots_[sql];
+					if(s.e && s.sql == sql)
+						return s.e;
+					if(slots_.size() > max_slots) {
+						slots_.clear();
+						return get(sql);
+					}
+					s.sql = sql;
+					s.e = registry::instance().get(normalize_query(s.sql));
+					return s.e;
+				}
+			private:
+				struct slot {
+					slot() : e(0) {}
+					std::string sql;
+					entry *e;
+				};
+				static size_t const max_slots = 4096;
+				std::unordered_map<char const *,slot> slots_;
+			};
+
+			class stats_observer : public query_observer {
+			public:
+				virtual void on_event(query_event const &e)
+				{
+					if(e.type == query_event::prepare_event)
+						return;
+					static thread_local thread_cache cache;
+					entry *en = cache.get(e.sql);
+					switch(e.type) {
+					case query_event::execute_event:
+						en->executions.fetch_add(1,std::memory_order_relaxed);
+						// the latency of queries is measured till the first row
+						if(!e.is_query)
+							en->latency.record(e.duration());
+						break;
+					case query_event::first_row_event:
+						en->latency.record(e.duration());
+						break;
+					case query_event::close_event:
+						en->rows.fetch_add(e.rows,std::memory_order_relaxed);
+						if(e.rows == 0)
+							en->latency.record(e.duration());
+						break;
+					case query_event::error_event:
+						en->errors.fetch_add(1,std::memory_order_relaxed);
+						break;
+					default:
+						;
+					}
+				}
+			};
+
+			class stderr_sink : public slow_query_sink {
+			public:
+				virtual void write(slow_query const &q)
+				{
+					std::string line = format_slow_query(q);
+					std::lock_guard<std::mutex> l(lock_);
+					std::cerr << line << std::endl;
+				}
+			private:
+				std::mutex lock_;
+			};
+
+			class sink_holder {
+			public:
+				static sink_holder &instance()
+				{
+					static sink_holder inst;
+					return inst;
+				}
+				std::shared_ptr<slow_query_sink> get()
+				{
+					std::lock_guard<std::mutex> l(lock_);
+					return sink_;
+				}
+				void set(std::shared_ptr<slow_query_sink> const &s)
+				{
+					std::lock_guard<std::mutex> l(lock_);
+					if(s)
+						sink_ = s;
+					else
+						sink_.reset(new stderr_sink());
+				}
+			private:
+				sink_holder() : sink_(new stderr_sink()) {}
+				std::mutex lock_;
+				std::shared_ptr<slow_query_sink> sink_;
+			};
+
+			//
+			// The events of a single connection come from one thread at a time, so no locking is needed.
+			// The prepare time is known only when the statement is created, it is kept till the following
+			// execution of the same statement, the queries are reported when their result is closed.
+			//
+			class slow_query_log : public query_observer {
+			public:
+				slow_query_log(std::chrono::nanoseconds threshold) :
+					threshold_(threshold),
+					has_prepare_(false),
+					prepare_(0)
+				{
+				}
+				virtual void on_event(query_event const &e)
+				{
+					switch(e.type) {
+					case query_event::prepare_event:
+						// the text is copied, the statement may be gone before it is executed
+						prepared_sql_ = e.sql;
+						has_prepare_ = true;
+						prepare_ = e.duration();
+						break;
+					case query_event::execute_event:
+						{
+							std::chrono::nanoseconds prepare = take_prepare(e.sql);
+							if(e.is_query)
+								start_fetch(e,prepare);
+							else if(prepare + e.duration() > threshold_)
+								report(e,prepare,e.duration(),std::chrono::nanoseconds(0));
+						}
+						break;
+					case query_event::close_event:
+						{
+							for(size_t i=0;i<pending_.size();i++) {
+								fetch_state const &f = pending_[i];
+								if(f.sql != e.sql || f.start != e.start)
+									continue;
+								std::chrono::nanoseconds fetch = e.time - f.fetch_start;
+								std::chrono::nanoseconds prepare = f.prepare, execute = f.execute;
+								pending_.erase(pending_.begin() + i);
+								if(prepare + execute + fetch > threshold_)
+									report(e,prepare,execute,fetch);
+								break;
+							}
+						}
+						break;
+					case query_event::error_event:
+						// failed fetches are reported by the close_event
+						if(e.operation == query_event::prepare_event) {
+							has_prepare_ = false;
+							if(e.duration() > threshold_)
+								report(e,e.duration(),std::chrono::nanoseconds(0),std::chrono::nanoseconds(0));
+						}
+						else if(e.operation == query_event::execute_event) {
+							std::chrono::nanoseconds prepare = take_prepare(e.sql);
+							if(prepare + e.duration() > threshold_)
+								report(e,prepare,e.duration(),std::chrono::nanoseconds(0));
+						}
+						break;
+					default:
+						;
+					}
+				}
+			private:
+				struct fetch_state {
+					char const *sql;
+					query_event::clock_type::time_point start;
+					query_event::clock_type::time_point fetch_start;
+					std::chrono::nanoseconds prepare;
+					std::chrono::nanoseconds execute;
+				};
+
+				std::chrono::nanoseconds take_prepare(char const *sql)
+				{
+					std::chrono::nanoseconds res(0);
+					if(has_prepare_ && prepared_sql_ == sql)
+						res = prepare_;
+					has_prepare_ = false;
+					return res;
+				}
+				void start_fetch(query_event const &e,std::chrono::nanoseconds prepare)
+				{
+					// the results that are never closed should not make the list grow
+					if(pending_.size() >= max_pending)
+						pending_.erase(pending_.begin());
+					fetch_state f;
+					f.sql = e.sql;
+					f.start = e.start;
+					f.fetch_start = e.time;
+					f.prepare = prepare;
+					f.execute = e.duration();
+					pending_.push_back(f);
+				}
+				void report(query_event const &e,std::chrono::nanoseconds prepare,std::chrono::nanoseconds execute,std::chrono::nanoseconds fetch)
+				{
+					slow_query q;
+					q.sql = e.sql;
+					if(e.values)
+						q.params = *e.values;
+					if(e.conn) {
+						q.driver = e.conn->driver();
+						q.engine = e.conn->engine();
+					}
+					q.prepare = prepare;
+					q.execute = execute;
+					q.fetch = fetch;
+					q.rows = e.rows;
+					q.affected = e.affected;
+					if(e.error)
+						q.error = e.error;
+					sink_holder::instance().get()->write(q);
+				}
+
+				static size_t const max_pending = 16;
+				std::chrono::nanoseconds threshold_;
+				std::string prepared_sql_;
+				bool has_prepare_;
+				std::chrono::nanoseconds prepare_;
+				std::vector<fetch_state> pending_;
+			};
+
+			void append_ms(std::string &out,char const *name,std::chrono::nanoseconds d)
+			{
+				char buf[64];
+				snprintf(buf,sizeof(buf),"%s%.3f ms",name,d.count() / 1e6);
+				out += buf;
+			}
+
+			bool is_identifier_char(char c)
+			{
+				return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c<= '9') || c=='_' || c=='$';
+			}
+			bool is_digit(char c)
+			{
+				return '0' <= c && c <= '9';
+			}
+		}
+
+		std::string normalize_query(std::string const &q)
+		{
+			std::string res;
+			res.reserve(q.size());
+			size_t i = 0, n = q.size();
+			bool pending_space = false;
+			while(i < n) {
+				char c = q[i];
+				if(c==' ' || c=='\t' || c=='\r' || c=='\n') {
+					pending_space = !res.empty();
+					i++;
+					continue;
+				}
+				if(pending_space) {
+					res += ' ';
+					pending_space = false;
+				}
+				char prev = res.empty() ? ' ' : res[res.size()-1];
+				if(c=='\'') {
+					// string literal, '' is an escaped quote
+					for(i++;i<n;i++) {
+						if(q[i]=='\'') {
+							if(i + 1 < n && q[i+1]=='\'')
+								i++;
+							else
+								break;
+						}
+					}
+					i++;
+					res += '?';
+				}
+				else if(c=='"') {
+					size_t end = q.find('"',i + 1);
+					end = end == std::string::npos ? n : end + 1;
+					res.append(q,i,end - i);
+					i = end;
+				}
+				else if(is_digit(c) && !is_identifier_char(prev)) {
+					while(i < n && (is_identifier_char(q[i]) || q[i]=='.'))
+						i++;
+					res += '?';
+				}
+				else {
+					res += c;
+					i++;
+				}
+			}
+			return res;
+		}
+
+		std::vector<query_stats> snapshot()
+		{
+			return registry::instance().snapshot();
+		}
+
+		void reset()
+		{
+			registry::instance().reset();
+		}
+
+		std::shared_ptr<query_observer> observer()
+		{
+			static std::shared_ptr<query_observer> inst(new stats_observer());
+			return inst;
+		}
+
+		void set_slow_query_sink(std::shared_ptr<slow_query_sink> const &s)
+		{
+			sink_holder::instance().set(s);
+		}
+
+		std::string format_slow_query(slow_query const &q)
+		{
+			std::string res = "cppdb: slow query ";
+			append_ms(res,"",q.total());
+			append_ms(res," (prepare ",q.prepare);
+			append_ms(res,", execute ",q.execute);
+			append_ms(res,", fetch ",q.fetch);
+			res += ", rows " + std::to_string(q.rows);
+			if(q.affected > 0)
+				res += ", affected " + std::to_string(q.affected);
+			res += ") [" + q.driver + "/" + q.engine + "] " + q.sql;
+			if(!q.params.empty()) {
+				res += " params: ";
+				for(size_t i=0;i<q.params.size();i++) {
+					if(i > 0)
+						res += ", ";
+					res += q.params[i];
+				}
+			}
+			if(!q.error.empty())
+				res += " error: " + q.error;
+			return res;
+		}
+
+		std::shared_ptr<query_observer> slow_query_observer(std::chrono::nanoseconds threshold)
+		{
+			return std::shared_ptr<query_observer>(new slow_query_log(threshold));
+		}
+	}
+}
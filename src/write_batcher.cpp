@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#define CPPDB_SOURCE
+#include <cppdb/write_batcher.h>
+#include <cppdb/frontend.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+namespace cppdb {
+
+	namespace {
+		struct item {
+			std::string query;
+			params values;
+			std::promise<unsigned long long> result;
+		};
+
+		unsigned long long execute(session &sql,item &it)
+		{
+			statement st = sql.prepare(it.query);
+			st.bind(it.values);
+			st.exec();
+			return st.affected();
+		}
+
+		void execute_batch(std::string const &cs,std::vector<item> &batch)
+		{
+			std::vector<unsigned long long> affected(batch.size());
+			try {
+				session sql;
+				sql.open_writer(cs);
+				transaction tr(sql);
+				for(size_t i=0;i<batch.size();i++)
+					affected[i] = execute(sql,batch[i]);
+				tr.commit();
+			}
+			catch(...) {
+				if(batch.size() == 1) {
+					batch[0].result.set_exception(std::current_exception());
+					return;
+				}
+				// find out which of the statements had failed
+				session sql;
+				for(size_t i=0;i<batch.size();i++) {
+					try {
+						if(!sql.is_open())
+							sql.open_writer(cs);
+						batch[i].result.set_value(execute(sql,batch[i]));
+					}
+					catch(...) {
+						// the connection may be unusable after the error
+						sql.close();
+						batch[i].result.set_exception(std::current_exception());
+					}
+				}
+				return;
+			}
+			for(size_t i=0;i<batch.size();i++)
+				batch[i].result.set_value(affected[i]);
+		}
+	}
+
+	struct write_batcher::data {
+		typedef std::chrono::steady_clock clock_type;
+
+		std::string connection_string;
+		size_t max_statements;
+		clock_type::duration max_delay;
+
+		std::mutex lock;
+		std::condition_variable wake;
+		std::condition_variable done;
+		std::vector<item> pending;
+		clock_type::time_point first_submitted;
+		unsigned long long submitted;
+		unsigned long long taken;
+		unsigned long long completed;
+		// everything submitted before this point should be executed without delay
+		unsigned long long flush_until;
+		bool stop;
+
+		std::thread worker;
+	};
+
+	write_batcher::write_batcher(std::string const &cs,size_t max_statements,int max_delay_ms) :
+		d(new data())
+	{
+		d->connection_string = cs;
+		d->max_statements = max_statements > 0 ? max_statements : 1;
+		d->max_delay = std::chrono::milliseconds(max_delay_ms > 0 ? max_delay_ms : 0);
+		d->pending.reserve(d->max_statements);
+		d->submitted = 0;
+		d->taken = 0;
+		d->completed = 0;
+		d->flush_until = 0;
+		d->stop = false;
+		d->worker = std::thread(&write_batcher::run,this);
+	}
+
+	write_batcher::~write_batcher()
+	{
+		{
+			std::lock_guard<std::mutex> l(d->lock);
+			d->stop = true;
+		}
+		d->wake.notify_one();
+		d->worker.join();
+	}
+
+	std::future<unsigned long long> write_batcher::submit(std::string const &query,params const &values)
+	{
+		return submit(query,params(values));
+	}
+
+	std::future<unsigned long long> write_batcher::submit(std::string const &query,params &&values)
+	{
+		std::future<unsigned long long> f;
+		bool full;
+		{
+			std::lock_guard<std::mutex> l(d->lock);
+			if(d->pending.empty())
+				d->first_submitted = data::clock_type::now();
+			d->pending.push_back(item());
+			item &it = d->pending.back();
+			it.query = query;
+			it.values = std::move(values);
+			f = it.result.get_future();
+			d->submitted++;
+			full = d->pending.size() >= d->max_statements;
+		}
+		if(full)
+			d->wake.notify_one();
+		return f;
+	}
+
+	void write_batcher::flush()
+	{
+		std::unique_lock<std::mutex> l(d->lock);
+		unsigned long long target = d->submitted;
+		d->flush_until = target;
+		d->wake.notify_one();
+		while(d->completed < target)
+			d->done.wait(l);
+	}
+
+	void write_batcher::run()
+	{
+		std::vector<item> batch;
+		batch.reserve(d->max_statements);
+		std::unique_lock<std::mutex> l(d->lock);
+		for(;;) {
+			while(d->pending.empty() && !d->stop)
+				d->wake.wait(l);
+			if(d->pending.empty())
+				break;
+			data::clock_type::time_point deadline = d->first_submitted + d->max_delay;
+			while(	!d->stop
+				&& d->taken >= d->flush_until
+				&& d->pending.size() < d->max_statements
+				&& d->wake.wait_until(l,deadline) != std::cv_status::timeout)
+			{
+			}
+			size_t n = std::min(d->pending.size(),d->max_statements);
+			std::move(d->pending.begin(),d->pending.begin() + n,std::back_inserter(batch));
+			d->pending.erase(d->pending.begin(),d->pending.begin() + n);
+			d->taken += n;
+
+			l.unlock();
+			execute_batch(d->connection_string,batch);
+			batch.clear();
+			l.lock();
+
+			d->completed += n;
+			d->done.notify_all();
+		}
+	}
+}
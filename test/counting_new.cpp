@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                             
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>     
+//                                                                             
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at 
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#include "counting_new.h"
+#include <new>
+#include <stdlib.h>
+
+std::atomic<bool> count_allocations(false);
+std::atomic<int> allocations(0);
+
+// the array and nothrow forms call these by default
+void *operator new(size_t n)
+{
+	if(count_allocations.load(std::memory_order_relaxed))
+		allocations.fetch_add(1,std::memory_order_relaxed);
+	void *p = malloc(n == 0 ? 1 : n);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p,size_t) noexcept
+{
+	free(p);
+}
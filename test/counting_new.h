@@ -0,0 +1,32 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                             
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>     
+//                                                                             
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at 
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPDB_TEST_COUNTING_NEW_H
+#define CPPDB_TEST_COUNTING_NEW_H
+
+#include <atomic>
+
+//
+// Global operator new replaced in counting_new.cpp, it is kept in its own translation
+// unit so the compiler does not mix the replacement with the default allocation functions
+//
+
+// count the calls to operator new while it is true
+extern std::atomic<bool> count_allocations;
+extern std::atomic<int> allocations;
+
+#endif
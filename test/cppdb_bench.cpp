@@ -0,0 +1,454 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Benchmark suite, runs a set of scenarios against any connection string
+// and reports the throughput and the latency percentiles as JSON.
+//
+// Usage: cppdb_bench [options] [connection_string]
+//
+//   -t, --threads N    the maximal number of threads for the multithreaded scenarios, default 8
+//   -n, --ops N        the number of operations per thread in each scenario, default 10000
+//   -r, --rows N       the number of rows in the test table, default 10000
+//   -s, --scenario S   run only scenario S, can be given several times
+//
+// The default connection string is sqlite3:db=cppdb_bench.db, when running from
+// the build directory without installing cppdb add @modules_path=. to find the driver.
+// The progress is written to the standard error and the results to the standard output.
+//
+#include <cppdb/frontend.h>
+#include <cppdb/stats.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <exception>
+#include <stdexcept>
+#include <stdlib.h>
+
+typedef std::chrono::steady_clock clock_type;
+
+struct options {
+	options() : threads(8), ops(10000), rows(10000), cs("sqlite3:db=cppdb_bench.db") {}
+	int threads;
+	int ops;
+	int rows;
+	std::string cs;
+	std::vector<std::string> scenarios;
+
+	bool enabled(std::string const &name) const
+	{
+		if(scenarios.empty())
+			return true;
+		for(size_t i=0;i<scenarios.size();i++)
+			if(scenarios[i] == name)
+				return true;
+		return false;
+	}
+};
+
+struct bench_result {
+	bench_result() : threads(1), operations(0), rows(0), seconds(0) {}
+	std::string scenario;
+	int threads;
+	unsigned long long operations;
+	unsigned long long rows;
+	double seconds;
+	std::chrono::nanoseconds p50,p99,p999,max;
+	std::vector<std::pair<std::string,unsigned long long> > counters;
+};
+
+// a uniformly distributed number in [0,n), rand() is not thread safe
+int random_int(int n)
+{
+	static thread_local std::minstd_rand generator(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	return std::uniform_int_distribution<int>(0,n - 1)(generator);
+}
+
+// operation number i of thread t, returns the number of processed rows
+typedef std::function<unsigned long long(cppdb::session &sql,int t,int i)> operation;
+// opens the session of thread t
+typedef std::function<void(cppdb::session &sql,int t)> thread_setup;
+
+class bench {
+public:
+	bench(options const &opt) : opt_(opt)
+	{
+	}
+
+	bench_result run(std::string const &name,int threads,int ops,thread_setup const &setup,operation const &op)
+	{
+		cppdb::latency_histogram latency;
+		std::vector<cppdb::session> sessions(threads);
+		for(int t=0;t<threads;t++)
+			setup(sessions[t],t);
+
+		std::atomic<bool> go(false);
+		std::atomic<unsigned long long> rows(0);
+		std::vector<std::exception_ptr> errors(threads);
+		std::vector<std::thread> workers;
+		for(int t=0;t<threads;t++) {
+			workers.push_back(std::thread([&,t]() {
+				try {
+					while(!go.load())
+						std::this_thread::yield();
+					unsigned long long n = 0;
+					for(int i=0;i<ops;i++) {
+						clock_type::time_point start = clock_type::now();
+						n += op(sessions[t],t,i);
+						latency.record(clock_type::now() - start);
+					}
+					rows += n;
+				}
+				catch(...) {
+					errors[t] = std::current_exception();
+				}
+			}));
+		}
+		clock_type::time_point start = clock_type::now();
+		go = true;
+		for(int t=0;t<threads;t++)
+			workers[t].join();
+		clock_type::time_point end = clock_type::now();
+		for(int t=0;t<threads;t++)
+			if(errors[t])
+				std::rethrow_exception(errors[t]);
+
+		bench_result r;
+		r.scenario = name;
+		r.threads = threads;
+		r.operations = latency.count();
+		r.rows = rows;
+		r.seconds = std::chrono::duration<double>(end - start).count();
+		r.p50 = latency.percentile(50);
+		r.p99 = latency.percentile(99);
+		r.p999 = latency.percentile(99.9);
+		r.max = latency.max_value();
+		std::cerr << name << " threads=" << threads << ": " << int(r.operations / r.seconds) << " ops/s" << std::endl;
+		return r;
+	}
+
+	bench_result run(std::string const &name,int ops,operation const &op)
+	{
+		std::string cs = opt_.cs;
+		return run(name,1,ops,[cs](cppdb::session &sql,int) { sql.open(cs); },op);
+	}
+
+	// 1, 2, 4, ... up to the maximal number of threads
+	std::vector<int> thread_counts() const
+	{
+		std::vector<int> res;
+		for(int n=1;n<opt_.threads;n*=2)
+			res.push_back(n);
+		res.push_back(opt_.threads);
+		return res;
+	}
+private:
+	options const &opt_;
+};
+
+std::string json_string(std::string const &s)
+{
+	std::ostringstream ss;
+	ss << '"';
+	for(size_t i=0;i<s.size();i++) {
+		unsigned char c = s[i];
+		if(c == '"' || c == '\\')
+			ss << '\\' << c;
+		else if(c < 0x20)
+			ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+		else
+			ss << c;
+	}
+	ss << '"';
+	return ss.str();
+}
+
+double micros(std::chrono::nanoseconds d)
+{
+	return d.count() / 1000.0;
+}
+
+void write_json(std::ostream &out,options const &opt,cppdb::session &sql,std::vector<bench_result> const &results)
+{
+	out << std::fixed << std::setprecision(3);
+	out << "{\n";
+	out << "  \"connection\": " << json_string(opt.cs) << ",\n";
+	out << "  \"driver\": " << json_string(sql.driver()) << ",\n";
+	out << "  \"engine\": " << json_string(sql.engine()) << ",\n";
+	out << "  \"results\": [";
+	for(size_t i=0;i<results.size();i++) {
+		bench_result const &r = results[i];
+		out << (i > 0 ? ",\n" : "\n");
+		out << "    { \"scenario\": " << json_string(r.scenario)
+			<< ", \"threads\": " << r.threads
+			<< ", \"operations\": " << r.operations
+			<< ", \"rows\": " << r.rows
+			<< ", \"seconds\": " << r.seconds
+			<< ", \"ops_per_sec\": " << (r.seconds > 0 ? r.operations / r.seconds : 0)
+			<< ", \"latency_us\": { \"p50\": " << micros(r.p50)
+			<< ", \"p99\": " << micros(r.p99)
+			<< ", \"p999\": " << micros(r.p999)
+			<< ", \"max\": " << micros(r.max) << " }";
+		for(size_t j=0;j<r.counters.size();j++)
+			out << ", " << json_string(r.counters[j].first) << ": " << r.counters[j].second;
+		out << " }";
+	}
+	out << "\n  ]\n}" << std::endl;
+}
+
+bool parse_options(int argc,char **argv,options &opt)
+{
+	for(int i=1;i<argc;i++) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if((arg == "-t" || arg == "--threads") && has_value)
+			opt.threads = atoi(argv[++i]);
+		else if((arg == "-n" || arg == "--ops") && has_value)
+			opt.ops = atoi(argv[++i]);
+		else if((arg == "-r" || arg == "--rows") && has_value)
+			opt.rows = atoi(argv[++i]);
+		else if((arg == "-s" || arg == "--scenario") && has_value)
+			opt.scenarios.push_back(argv[++i]);
+		else if(!arg.empty() && arg[0] != '-')
+			opt.cs = arg;
+		else
+			return false;
+	}
+	return opt.threads > 0 && opt.ops > 0 && opt.rows > 0;
+}
+
+std::string blob_type(std::string const &engine)
+{
+	if(engine == "postgresql")
+		return "bytea";
+	if(engine == "mysql")
+		return "longblob";
+	if(engine == "mssql")
+		return "varbinary(max)";
+	return "blob";
+}
+
+void create_table(cppdb::session &sql,std::string const &name,std::string const &columns)
+{
+	try { sql << "DROP TABLE " + name << cppdb::exec; } catch(...) {}
+	std::string q = "CREATE TABLE " + name + "(" + columns + ")";
+	if(sql.engine() == "mysql")
+		q += " Engine=innodb";
+	sql << q << cppdb::exec;
+}
+
+int main(int argc,char **argv)
+{
+	options opt;
+	if(!parse_options(argc,argv,opt)) {
+		std::cerr << "Usage: cppdb_bench [-t threads] [-n ops] [-r rows] [-s scenario]... [connection_string]" << std::endl;
+		return 1;
+	}
+	try {
+		bench b(opt);
+		std::vector<bench_result> results;
+		std::string const cs = opt.cs;
+		int const rows = opt.rows;
+		int const ops = opt.ops;
+
+		cppdb::session sql(cs);
+		create_table(sql,"bench","id integer primary key, n integer, val varchar(100)");
+		{
+			cppdb::transaction tr(sql);
+			cppdb::statement st = sql << "INSERT INTO bench(id,n,val) VALUES(?,?,?)";
+			for(int i=0;i<rows;i++) {
+				st.reset();
+				st << i << i * 2 << "Hello World" << cppdb::exec;
+			}
+			tr.commit();
+		}
+		std::vector<int> sweep = b.thread_counts();
+
+		if(opt.enabled("point_select")) {
+			for(size_t i=0;i<sweep.size();i++) {
+				results.push_back(b.run("point_select",sweep[i],ops,
+					[cs](cppdb::session &s,int) { s.open(cs); },
+					[rows](cppdb::session &s,int,int) -> unsigned long long {
+						std::string v;
+						s << "SELECT val FROM bench WHERE id=?" << random_int(rows) << cppdb::row >> v;
+						if(v != "Hello World")
+							throw std::runtime_error("point_select: wrong value");
+						return 1;
+					}));
+			}
+		}
+		int const range = rows < 100 ? rows : 100;
+		if(opt.enabled("range_scan")) {
+			for(size_t i=0;i<sweep.size();i++) {
+				results.push_back(b.run("range_scan",sweep[i],ops / 10 + 1,
+					[cs](cppdb::session &s,int) { s.open(cs); },
+					[rows,range](cppdb::session &s,int,int) -> unsigned long long {
+						int first = random_int(rows - range + 1);
+						cppdb::result r = s << "SELECT id,n,val FROM bench WHERE id BETWEEN ? AND ?" << first << first + range - 1;
+						unsigned long long n = 0;
+						while(r.next())
+							n++;
+						return n;
+					}));
+			}
+		}
+		if(opt.enabled("fetch_by_index") || opt.enabled("fetch_by_name")) {
+			for(int by_name=0;by_name<2;by_name++) {
+				std::string name = by_name ? "fetch_by_name" : "fetch_by_index";
+				if(!opt.enabled(name))
+					continue;
+				results.push_back(b.run(name,ops / 10 + 1,
+					[rows,range,by_name](cppdb::session &s,int,int) -> unsigned long long {
+						int first = random_int(rows - range + 1);
+						cppdb::result r = s << "SELECT id,n,val FROM bench WHERE id BETWEEN ? AND ?" << first << first + range - 1;
+						unsigned long long n = 0;
+						long long sum = 0;
+						std::string v;
+						while(r.next()) {
+							if(by_name) {
+								sum += r.get<long long>("id") + r.get<long long>("n");
+								r.fetch("val",v);
+							}
+							else {
+								sum += r.get<long long>(0) + r.get<long long>(1);
+								r.fetch(2,v);
+							}
+							n++;
+						}
+						if(sum < 0)
+							throw std::runtime_error("fetch: wrong value");
+						return n;
+					}));
+			}
+		}
+		if(opt.enabled("insert")) {
+			create_table(sql,"bench_ins","id integer primary key, n integer, val varchar(100)");
+			// a single transaction so the disk synchronization does not dominate
+			sql.begin();
+			results.push_back(b.run("insert",1,ops,
+				[&sql](cppdb::session &s,int) { s = sql; },
+				[](cppdb::session &s,int,int i) -> unsigned long long {
+					s << "INSERT INTO bench_ins(id,n,val) VALUES(?,?,?)" << i << i << "Hello World" << cppdb::exec;
+					return 1;
+				}));
+			sql.commit();
+			sql << "DROP TABLE bench_ins" << cppdb::exec;
+		}
+		if(opt.enabled("bulk_insert")) {
+			int const batch = 1000;
+			create_table(sql,"bench_ins","id integer primary key, n integer, val varchar(100)");
+			std::vector<std::string> columns;
+			columns.push_back("id");
+			columns.push_back("n");
+			columns.push_back("val");
+			results.push_back(b.run("bulk_insert",1,ops / batch + 1,
+				[&sql](cppdb::session &s,int) { s = sql; },
+				[&columns,batch](cppdb::session &s,int,int i) -> unsigned long long {
+					int id = i * batch;
+					int end = id + batch;
+					return s.bulk_load("bench_ins",columns,[&](cppdb::params &row) {
+						if(id >= end)
+							return false;
+						row << id << id << "Hello World";
+						id++;
+						return true;
+					});
+				}));
+			sql << "DROP TABLE bench_ins" << cppdb::exec;
+		}
+		if(opt.enabled("blob_roundtrip")) {
+			size_t const blob_size = 64 * 1024;
+			create_table(sql,"bench_blob","id integer primary key, data " + blob_type(sql.engine()));
+			std::string data(blob_size,'\0');
+			for(size_t i=0;i<data.size();i++)
+				data[i] = char(i * 37);
+			results.push_back(b.run("blob_roundtrip",1,ops / 10 + 1,
+				[&sql](cppdb::session &s,int) { s = sql; },
+				[&data](cppdb::session &s,int,int i) -> unsigned long long {
+					std::istringstream in(data);
+					cppdb::statement st = s << "INSERT INTO bench_blob(id,data) VALUES(?,?)" << i;
+					st.bind(in);
+					st.exec();
+					std::ostringstream out;
+					cppdb::result r = s << "SELECT data FROM bench_blob WHERE id=?" << i << cppdb::row;
+					r.fetch(0,out);
+					if(out.str().size() != data.size())
+						throw std::runtime_error("blob_roundtrip: wrong size");
+					return 1;
+				}));
+			sql << "DROP TABLE bench_blob" << cppdb::exec;
+		}
+		if(opt.enabled("pool_checkout")) {
+			// half as many pooled connections as threads, so the threads compete for them
+			std::ostringstream pooled;
+			pooled << cs << ";@pool_size=" << (opt.threads + 1) / 2;
+			std::string pool_cs = pooled.str();
+			for(size_t i=0;i<sweep.size();i++) {
+				results.push_back(b.run("pool_checkout",sweep[i],ops,
+					[](cppdb::session &,int) {},
+					[pool_cs,rows](cppdb::session &,int,int) -> unsigned long long {
+						cppdb::session s(pool_cs);
+						int v = -1;
+						s << "SELECT n FROM bench WHERE id=?" << random_int(rows) << cppdb::row >> v;
+						return 1;
+					}));
+			}
+		}
+		if(opt.enabled("stmt_cache_churn")) {
+			// twice as many distinct queries as the cache holds, so each one is evicted before it is used again
+			int const cache_size = 32;
+			std::vector<std::string> queries;
+			for(int i=0;i<cache_size * 2;i++) {
+				std::ostringstream q;
+				q << "SELECT val FROM bench WHERE id=? AND " << i << "=" << i;
+				queries.push_back(q.str());
+			}
+			std::ostringstream small_cache;
+			small_cache << cs << ";@stmt_cache_size=" << cache_size;
+			std::string churn_cs = small_cache.str();
+			cppdb::session churn(churn_cs);
+			bench_result r = b.run("stmt_cache_churn",1,ops,
+				[&churn](cppdb::session &s,int) { s = churn; },
+				[&queries,rows](cppdb::session &s,int,int i) -> unsigned long long {
+					std::string v;
+					s << queries[i % queries.size()] << random_int(rows) << cppdb::row >> v;
+					return 1;
+				});
+			cppdb::statement_cache_stats cache = churn.cache_stats();
+			r.counters.push_back(std::make_pair("cache_hits",cache.hits));
+			r.counters.push_back(std::make_pair("cache_misses",cache.misses));
+			r.counters.push_back(std::make_pair("cache_evictions",cache.evictions));
+			results.push_back(r);
+		}
+
+		sql << "DROP TABLE bench" << cppdb::exec;
+		write_json(std::cout,opt,sql,results);
+	}
+	catch(std::exception const &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2010-2011  Artyom Beilis (Tonkikh) <artyomtnk@yahoo.com>
+//
+//  Distributed under:
+//
+//                   the Boost Software License, Version 1.0.
+//              (See accompanying file LICENSE_1_0.txt or copy at
+//                     http://www.boost.org/LICENSE_1_0.txt)
+//
+//  or (at your opinion) under:
+//
+//                               The MIT License
+//                 (See accompanying file MIT.txt or a copy at
+//              http://www.opensource.org/licenses/mit-license.php)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Microbenchmarks of the frontend overhead, the statements are executed by the
+// dummy driver that does nothing, so only the time spent by cppdb itself is measured.
+//
+// Usage: cppdb_microbench [iterations]
+//
+// The results are written to the standard output as JSON.
+//
+#include <cppdb/frontend.h>
+#include <cppdb/driver_manager.h>
+#include <cppdb/pool.h>
+#include "dummy_driver.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <stdlib.h>
+
+typedef std::chrono::steady_clock clock_type;
+
+struct bench_result {
+	std::string name;
+	long iterations;
+	double ns_per_op;
+};
+
+// keeps the compiler from removing the measured code
+volatile long sink = 0;
+
+bench_result measure(std::string const &name,long iterations,std::function<void(long)> const &op)
+{
+	// warm up the caches and the allocator
+	for(long i=0;i<iterations / 10;i++)
+		op(i);
+	clock_type::time_point start = clock_type::now();
+	for(long i=0;i<iterations;i++)
+		op(i);
+	clock_type::time_point end = clock_type::now();
+	bench_result r;
+	r.name = name;
+	r.iterations = iterations;
+	r.ns_per_op = std::chrono::duration<double,std::nano>(end - start).count() / iterations;
+	std::cerr << std::setw(20) << std::left << name << std::fixed << std::setprecision(1) << r.ns_per_op << " ns/op" << std::endl;
+	return r;
+}
+
+struct object : public cppdb::ref_counted {
+};
+
+int main(int argc,char **argv)
+{
+	long iterations = 1000000;
+	if(argc >= 2)
+		iterations = atol(argv[1]);
+	if(argc > 2 || iterations <= 0) {
+		std::cerr << "Usage: cppdb_microbench [iterations]" << std::endl;
+		return 1;
+	}
+	try {
+		cppdb::driver_manager::instance().install_driver("dummy",new dummy::loadable_driver());
+		std::vector<bench_result> results;
+
+		cppdb::session sql("dummy:");
+		results.push_back(measure("prepare_cache_hit",iterations,[&](long) {
+			cppdb::statement st = sql.prepare("SELECT a FROM t WHERE id=?");
+		}));
+
+		{
+			// cycling over twice as many queries as the cache holds makes every one of them miss
+			int const cache_size = 16;
+			std::vector<std::string> queries;
+			for(int i=0;i<cache_size * 2;i++) {
+				std::ostringstream q;
+				q << "SELECT a FROM t WHERE id=? AND " << i << "=" << i;
+				queries.push_back(q.str());
+			}
+			std::ostringstream cs;
+			cs << "dummy:@stmt_cache_size=" << cache_size;
+			cppdb::session small(cs.str());
+			results.push_back(measure("prepare_cache_miss",iterations,[&](long i) {
+				cppdb::statement st = small.prepare(queries[i % queries.size()]);
+			}));
+		}
+
+		{
+			cppdb::statement st = sql.prepare("INSERT INTO t(a,b,c) VALUES(?,?,?)");
+			std::string text = "Hello World";
+			results.push_back(measure("bind",iterations,[&](long i) {
+				st.reset();
+				st << int(i) << 3.14 << text;
+			}));
+			results.push_back(measure("exec",iterations,[&](long) {
+				st.exec();
+			}));
+		}
+
+		{
+			cppdb::statement st = sql.prepare("SELECT c0,c1,c2,c3 FROM t");
+			results.push_back(measure("query",iterations,[&](long) {
+				cppdb::result r = st.query();
+				sink = sink + r.next();
+			}));
+			cppdb::result r = st.query();
+			r.next();
+			int v = 0;
+			results.push_back(measure("fetch_by_index",iterations,[&](long) {
+				sink = sink + r.fetch(3,v);
+			}));
+			results.push_back(measure("fetch_by_name",iterations,[&](long) {
+				sink = sink + r.fetch("c3",v);
+			}));
+		}
+
+		{
+			cppdb::ref_ptr<object> p(new object());
+			results.push_back(measure("ref_ptr_copy",iterations,[&](long) {
+				cppdb::ref_ptr<object> copy = p;
+				sink = sink + copy->use_count();
+			}));
+		}
+
+		{
+			cppdb::pool::pointer p = cppdb::pool::create("dummy:@pool_size=4");
+			results.push_back(measure("pool_open_put",iterations,[&](long) {
+				cppdb::ref_ptr<cppdb::backend::connection> c = p->open();
+			}));
+			p->clear();
+		}
+
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "{\n  \"iterations\": " << iterations << ",\n  \"results\": [";
+		for(size_t i=0;i<results.size();i++) {
+			std::cout << (i > 0 ? ",\n" : "\n");
+			std::cout << "    { \"benchmark\": \"" << results[i].name << "\", \"ns_per_op\": " << results[i].ns_per_op << " }";
+		}
+		std::cout << "\n  ]\n}" << std::endl;
+	}
+	catch(std::exception const &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
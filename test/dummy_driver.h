@@ -56,12 +56,15 @@ namespace dummy {
 		virtual bool fetch(int,std::tm &){ return false; }
 		virtual bool is_null(int){ return true; }
 		virtual int cols() { return 10; }
-		virtual int name_to_column(std::string const &) {
-			return -1;
+		// the columns are named c0 ... c9
+		virtual int name_to_column(std::string const &n) {
+			if(n.size() != 2 || n[0] != 'c' || n[1] < '0' || n[1] > '9')
+				return -1;
+			return n[1] - '0';
 		}
-		virtual std::string column_to_name(int) 
+		virtual std::string column_to_name(int col) 
 		{
-			throw cppdb::not_supported_by_backend("unsupported");
+			return std::string(1,'c') + char('0' + col);
 		}
 
 		// End of API
@@ -299,6 +299,9 @@ void test3(cppdb::ref_ptr<cppdb::backend::connection> sql)
 			TEST(!res->is_null(4));
 		TEST(i==10);
 		TEST(3.1399 <= r && r <= 3.1401);
+		std::string rs;
+		TEST(res->fetch(1,rs));
+		TEST(rs == "3.14");
 		TEST(mktime(&t)==now);
 		TEST(s=="'to be' \\'or not' to be");
 		if(test_blob)
@@ -309,6 +312,15 @@ void test3(cppdb::ref_ptr<cppdb::backend::connection> sql)
 	if(pq_oid) {
 		sql->commit();
 	}
+	if(sql->engine() == "mssql" || sql->engine() == "mysql" || sql->engine() == "postgresql") {
+		stmt = sql->prepare("select cast('2011-03-05' as date)");
+		res = stmt->query();
+		TEST(res->next());
+		std::string ds;
+		TEST(res->fetch(0,ds));
+		TEST(ds == "2011-03-05");
+		res.reset();
+	}
 	stmt = sql->prepare("DELETE FROM test where 1<>0");
 	stmt->exec();
 	TEST(stmt->affected()==2);
@@ -17,8 +17,15 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <cppdb/frontend.h>
 #include <cppdb/connection_specific.h>
+#include <cppdb/write_batcher.h>
+#include <cppdb/observer.h>
+#include <cppdb/stats.h>
+#include "counting_new.h"
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <future>
 
 #define TEST(x) do { if(x) break; std::ostringstream ss; ss<<"Failed in " << __LINE__ <<' '<< #x; throw std::runtime_error(ss.str()); } while(0)
 
@@ -48,6 +55,42 @@ struct functor_caller {
 	}
 };
 
+struct slow_query_recorder : public cppdb::stats::slow_query_sink {
+	std::vector<cppdb::stats::slow_query> queries;
+	virtual void write(cppdb::stats::slow_query const &q)
+	{
+		queries.push_back(q);
+	}
+};
+
+struct event_recorder : public cppdb::query_observer {
+	std::vector<cppdb::query_event::event_type> events;
+	unsigned long long rows;
+	unsigned long long affected;
+	int params;
+	event_recorder() : rows(0), affected(0), params(0) {}
+	virtual void on_event(cppdb::query_event const &e)
+	{
+		events.push_back(e.type);
+		if(e.type == cppdb::query_event::execute_event)
+			params = e.params;
+		if(e.type == cppdb::query_event::close_event)
+			rows = e.rows;
+		affected += e.affected;
+	}
+};
+
+void point_select(cppdb::session &sql,int id)
+{
+	int n = -1;
+	std::string name;
+	cppdb::result r = sql << "SELECT n,name FROM test WHERE id=?" << id << cppdb::row;
+	r.fetch("n",n);
+	r.fetch(1,name);
+	TEST(n==10);
+	TEST(name=="Hello 'World'");
+}
+
 
 int main(int argc,char **argv)
 {
@@ -146,6 +189,50 @@ int main(int argc,char **argv)
 		TEST(val == 10);
 		res.clear();
 
+		for(int i=1;i<=2;i++) {
+			res = sql << "SELECT id,n AS val,name FROM test WHERE id=?" << i << cppdb::row;
+			TEST(res.get<int>("id") == i);
+			TEST(res.get<int>(std::string("val")) == 10);
+			TEST(res.find_column("name") == 2);
+			TEST(res.find_column("nothing") == -1);
+			TEST(!res.is_null("name"));
+			bool thrown = false;
+			try { res.index("nothing"); } catch(cppdb::invalid_column const &) { thrown = true; }
+			TEST(thrown);
+			res.clear();
+		}
+
+		{
+			// same number of columns with other names after the table is recreated
+			sql << "CREATE TABLE renamed(a integer,b integer)" << cppdb::exec;
+			sql << "INSERT INTO renamed(a,b) VALUES(1,2)" << cppdb::exec;
+			res = sql << "SELECT * FROM renamed" << cppdb::row;
+			TEST(res.get<int>("a") == 1);
+			res.clear();
+			sql << "DROP TABLE renamed" << cppdb::exec;
+			sql << "CREATE TABLE renamed(b integer,a integer)" << cppdb::exec;
+			sql << "INSERT INTO renamed(b,a) VALUES(2,1)" << cppdb::exec;
+			res = sql << "SELECT * FROM renamed" << cppdb::row;
+			TEST(res.find_column("a") == 1);
+			TEST(res.get<int>("a") == 1);
+			TEST(res.get<int>("b") == 2);
+			res.clear();
+			sql << "DROP TABLE renamed" << cppdb::exec;
+		}
+
+		{
+			for(int i=0;i<3;i++)
+				point_select(sql,1 + i % 2);
+			allocations = 0;
+			count_allocations = true;
+			for(int i=0;i<100;i++)
+				point_select(sql,1 + i % 2);
+			count_allocations = false;
+			std::cout << "Allocations in steady state query loop: " << allocations << std::endl;
+			if(sql.driver() == "sqlite3" && cs.find("@use_prepared=off")==std::string::npos)
+				TEST(allocations == 0);
+		}
+
 		cppdb::statement stat = sql<<"delete from test where 1<>0" << cppdb::exec;
 		std::cout<<"Deleted "<<stat.affected()<<" rows\n";
 		TEST(stat.affected()==2);
@@ -154,6 +241,297 @@ int main(int argc,char **argv)
 		TEST(stat.empty());
 		TEST(cppdb::statement().empty());
 
+		{
+			std::vector<std::string> columns = { "n", "f", "name" };
+			int i = 0;
+			unsigned long long loaded = sql.bulk_load("test",columns,[&](cppdb::params &row) {
+				if(i >= 250)
+					return false;
+				row << i << 0.5;
+				if(i % 10 == 0)
+					row.add_null();
+				else
+					row << "a\tb\\c\nd";
+				i++;
+				return true;
+			});
+			TEST(loaded == 250);
+			cppdb::result r = sql << "SELECT count(*),sum(n),count(name) FROM test" << cppdb::row;
+			TEST(r.get<int>(0) == 250);
+			TEST(r.get<int>(1) == 250*249/2);
+			TEST(r.get<int>(2) == 225);
+			r = sql << "SELECT f,name FROM test WHERE n=7" << cppdb::row;
+			TEST(r.get<double>(0) == 0.5);
+			TEST(r.get<std::string>(1) == "a\tb\\c\nd");
+			sql << "DELETE FROM test" << cppdb::exec;
+		}
+		{
+			sql << "INSERT INTO test(n,name) VALUES(1,'first')" << cppdb::exec;
+			std::string name = "first";
+			cppdb::statement st = sql << "SELECT n FROM test WHERE name=?";
+			st << name;
+			cppdb::result r = st.query();
+			name = "changed"; // query() is done, the bound text is no longer referenced
+			TEST(r.next());
+			TEST(r.get<int>(0) == 1);
+			r.clear();
+			st.reset();
+			sql << "DELETE FROM test" << cppdb::exec;
+		}
+		{
+			std::vector<std::future<unsigned long long> > results;
+			{
+				cppdb::write_batcher batcher(cs,16,5);
+				std::vector<std::thread> threads;
+				std::mutex lock;
+				for(int t=0;t<4;t++) {
+					threads.push_back(std::thread([&,t]() {
+						for(int i=0;i<25;i++) {
+							cppdb::params values;
+							values << t*100 + i << "batch";
+							std::future<unsigned long long> f = batcher.submit("INSERT INTO test(n,name) VALUES(?,?)",std::move(values));
+							std::lock_guard<std::mutex> l(lock);
+							results.push_back(std::move(f));
+						}
+					}));
+				}
+				for(size_t i=0;i<threads.size();i++)
+					threads[i].join();
+				results.push_back(batcher.submit("INSERT INTO no_such_table(n) VALUES(1)"));
+				batcher.flush();
+				TEST(results.back().wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+			}
+			bool thrown = false;
+			try { results.back().get(); } catch(cppdb::cppdb_error const &) { thrown = true; }
+			TEST(thrown);
+			results.pop_back();
+			for(size_t i=0;i<results.size();i++)
+				TEST(results[i].get() == 1);
+			cppdb::result r = sql << "SELECT count(*) FROM test WHERE name='batch'" << cppdb::row;
+			TEST(r.get<int>(0) == 100);
+			r.clear();
+			sql << "DELETE FROM test" << cppdb::exec;
+		}
+		if(sql.driver() == "sqlite3") {
+			sql << "DROP TABLE IF EXISTS blobs" << cppdb::exec;
+			sql << "CREATE TABLE blobs(id integer primary key, data blob)" << cppdb::exec;
+			std::string data;
+			for(int i=0;i<200000;i++)
+				data += char(i % 251);
+			std::istringstream in(data);
+			cppdb::statement st = sql << "INSERT INTO blobs(data) VALUES(?)";
+			st.bind(in);
+			st.exec();
+			long long id = st.last_insert_id();
+			std::ostringstream out;
+			cppdb::result r = sql << "SELECT data FROM blobs WHERE id=?" << id << cppdb::row;
+			r.fetch(0,out);
+			TEST(out.str() == data);
+			r.clear();
+
+			st = sql << "INSERT INTO blobs(data) VALUES(zeroblob(?))" << int(data.size()) << cppdb::exec;
+			id = st.last_insert_id();
+			st.clear();
+			std::istringstream in2(data);
+			sql.blob_write("blobs","data",id,in2);
+			std::ostringstream out2;
+			sql.blob_read("blobs","data",id,out2);
+			TEST(out2.str() == data);
+			sql << "DROP TABLE blobs" << cppdb::exec;
+		}
+		{
+			// executed again without binding after the bound text is gone
+			cppdb::statement st = sql.prepare("INSERT INTO test(n,name) VALUES(?,?)");
+			{
+				std::string name(100,'x');
+				st << 20 << name;
+				st.exec();
+			}
+			{
+				std::string other(100,'y');
+				st.exec();
+			}
+			st.reset();
+			cppdb::result r = sql << "SELECT count(*) FROM test WHERE n=20 AND name=?" << std::string(100,'x') << cppdb::row;
+			TEST(r.get<int>(0) == 2);
+			sql << "DELETE FROM test" << cppdb::exec;
+		}
+		{
+			cppdb::params values;
+			values << 5 << "returning";
+			long long id = sql.insert_returning_id("INSERT INTO test(n,name) VALUES(?,?)","id",values,"test_id_seq");
+			cppdb::result r = sql << "SELECT n FROM test WHERE id=?" << id << cppdb::row;
+			TEST(!r.empty());
+			TEST(r.get<int>(0) == 5);
+			values.clear();
+			values << 6 << "returning";
+			id = sql.insert_returning_id("INSERT INTO test(n,name) VALUES(?,?) ;\n","id",values,"test_id_seq");
+			r = sql << "SELECT n FROM test WHERE id=?" << id << cppdb::row;
+			TEST(!r.empty());
+			TEST(r.get<int>(0) == 6);
+			sql << "DELETE FROM test" << cppdb::exec;
+		}
+		{
+			std::shared_ptr<event_recorder> rec(new event_recorder());
+			sql.add_observer(rec);
+			sql << "INSERT INTO test(n,name) VALUES(?,?)" << 1 << "observed" << cppdb::exec;
+			sql << "INSERT INTO test(n,name) VALUES(?,?)" << 2 << "observed" << cppdb::exec;
+			TEST(rec->affected == 2);
+			TEST(rec->params == 2);
+			{
+				cppdb::statement st = sql.prepare("INSERT INTO test(n,name) VALUES(?,?)");
+				st.bind(2,"observed");
+				st.bind(1,3);
+				st.exec();
+				TEST(rec->params == 2);
+				sql << "DELETE FROM test WHERE n=3" << cppdb::exec;
+			}
+			rec->events.clear();
+			{
+				cppdb::result r = sql << "SELECT n FROM test WHERE name=? ORDER BY n" << "observed";
+				while(r.next())
+					;
+			}
+			TEST(rec->events.size() >= 3);
+			TEST(rec->events[rec->events.size()-3] == cppdb::query_event::execute_event);
+			TEST(rec->events[rec->events.size()-2] == cppdb::query_event::first_row_event);
+			TEST(rec->events.back() == cppdb::query_event::close_event);
+			TEST(rec->rows == 2);
+			rec->affected = 0;
+			std::vector<std::string> columns = { "n", "name" };
+			int i = 0;
+			sql.bulk_load("test",columns,[&](cppdb::params &row) {
+				if(i >= 3)
+					return false;
+				row << i++ << "bulk";
+				return true;
+			});
+			TEST(rec->affected == 3);
+			sql.remove_observer(rec.get());
+			rec->events.clear();
+			sql << "DELETE FROM test" << cppdb::exec;
+			TEST(rec->events.empty());
+			cppdb::add_global_observer(rec);
+			sql << "DELETE FROM test" << cppdb::exec;
+			TEST(!rec->events.empty() && rec->events.back() == cppdb::query_event::execute_event);
+			cppdb::remove_global_observer(rec.get());
+		}
+		{
+			cppdb::latency_histogram h;
+			for(int i=1;i<=1000;i++)
+				h.record(std::chrono::microseconds(i));
+			TEST(h.count() == 1000);
+			TEST(h.max_value() == std::chrono::microseconds(1000));
+			long long p50 = std::chrono::duration_cast<std::chrono::microseconds>(h.percentile(50)).count();
+			long long p99 = std::chrono::duration_cast<std::chrono::microseconds>(h.percentile(99)).count();
+			TEST(485 <= p50 && p50 <= 515);
+			TEST(960 <= p99 && p99 <= 1000);
+			TEST(cppdb::stats::normalize_query("SELECT  a1 FROM t\n WHERE x=10 AND y='it''s'") == "SELECT a1 FROM t WHERE x=? AND y=?");
+
+			cppdb::session observed(cs + ";@query_stats=on");
+			for(int i=0;i<3;i++) {
+				std::ostringstream q;
+				q << "SELECT n FROM test WHERE n > " << i * 100;
+				cppdb::result r = observed << q.str();
+				while(r.next())
+					;
+			}
+			std::vector<cppdb::stats::query_stats> all = cppdb::stats::snapshot();
+			bool found = false;
+			for(size_t i=0;i<all.size();i++) {
+				if(all[i].query == "SELECT n FROM test WHERE n > ?") {
+					found = true;
+					TEST(all[i].executions == 3);
+					TEST(all[i].p50 <= all[i].max);
+				}
+			}
+			TEST(found);
+			cppdb::stats::reset();
+			all = cppdb::stats::snapshot();
+			for(size_t i=0;i<all.size();i++)
+				TEST(all[i].executions == 0);
+		}
+		{
+			std::shared_ptr<slow_query_recorder> rec(new slow_query_recorder());
+			cppdb::stats::set_slow_query_sink(rec);
+			cppdb::session observed(cs + ";@slow_query_ms=1");
+			{
+				cppdb::result r = observed <<
+					"WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < ?) SELECT x FROM c"
+					<< 200000;
+				while(r.next())
+					;
+			}
+			cppdb::stats::set_slow_query_sink(std::shared_ptr<cppdb::stats::slow_query_sink>());
+			TEST(rec->queries.size() == 1);
+			cppdb::stats::slow_query const &q = rec->queries[0];
+			TEST(q.sql.find("WITH RECURSIVE") == 0);
+			TEST(q.params.size() == 1 && q.params[0] == "200000");
+			TEST(q.rows == 200000);
+			TEST(q.driver == observed.driver());
+			TEST(q.total() > std::chrono::milliseconds(1));
+			// a new connection, so the statement was just prepared
+			TEST(q.prepare > std::chrono::nanoseconds(0));
+			TEST(cppdb::stats::format_slow_query(q).find("params: 200000") != std::string::npos);
+		}
+		{
+			std::string name = "async";
+			cppdb::statement ins = sql << "INSERT INTO test(n,name) VALUES(?,?)" << 7 << name;
+			std::future<unsigned long long> affected = ins.exec_async();
+			TEST(affected.get() == 1);
+			ins.reset();
+			cppdb::statement sel = sql << "SELECT n FROM test WHERE name=?" << name;
+			std::future<cppdb::result> res = sel.query_async();
+			cppdb::result r = res.get();
+			TEST(r.next());
+			TEST(r.get<int>(0) == 7);
+			TEST(!r.next());
+			r.clear();
+			sel.reset();
+			{
+				// the task releases its copy of a temporary statement before the future is ready,
+				// so it is back in the cache when the caller prepares it again
+				std::future<unsigned long long> f = (sql << "UPDATE test SET n=? WHERE name=?" << 8 << name).exec_async();
+				TEST(f.get() == 1);
+				if(sql.driver() == "sqlite3" && cs.find("@use_prepared=off")==std::string::npos) {
+					unsigned long long hits = sql.cache_stats().hits;
+					sql << "UPDATE test SET n=? WHERE name=?" << 7 << name << cppdb::exec;
+					TEST(sql.cache_stats().hits == hits + 1);
+				}
+			}
+			{
+				// the connection is not recycled after the failure, so use another one
+				cppdb::session other(cs);
+				cppdb::result r = other << "SELECT id FROM test WHERE name=?" << name << cppdb::row;
+				cppdb::statement bad = other << "INSERT INTO test(id,n) VALUES(?,?)" << r.get<long long>(0) << 8;
+				r.clear();
+				std::future<unsigned long long> failed = bad.exec_async();
+				bool thrown = false;
+				try { failed.get(); } catch(cppdb::cppdb_error const &) { thrown = true; }
+				TEST(thrown);
+			}
+			sql << "DELETE FROM test" << cppdb::exec;
+		}
+
+		{
+			cppdb::statement st1 = sql << "SELECT count(*) FROM test";
+			cppdb::statement st2(std::move(st1));
+			TEST(st1.empty());
+			TEST(!st2.empty());
+			cppdb::result r1 = st2.query();
+			cppdb::result r2;
+			r2 = std::move(r1);
+			TEST(r1.empty());
+			TEST(r2.next());
+			TEST(r2.get<int>(0) == 0);
+			cppdb::session s2(std::move(sql));
+			TEST(!sql.is_open());
+			TEST(s2.is_open());
+			sql = std::move(s2);
+			TEST(sql.is_open());
+			TEST(!s2.is_open());
+		}
+
 		sql.reset_specific(new my_specific_a(10));
 		TEST(sql.get_specific<my_specific_b>()==0);
 		TEST(sql.get_specific<my_specific_a>()!=0);
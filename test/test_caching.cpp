@@ -17,8 +17,12 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <cppdb/driver_manager.h>
 #include <cppdb/conn_manager.h>
+#include <cppdb/pool.h>
 #include "test.h"
 #include "dummy_driver.h" 
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 #if ( defined(WIN32) || defined(_WIN32) || defined(__WIN32) ) && !defined(__CYGWIN__)
 # ifndef NOMINMAX
@@ -151,6 +155,172 @@ void test_stmt_cache()
 
 }
 
+void test_stmt_cache_stats()
+{
+	cppdb::ref_ptr<cppdb::backend::connection> c;
+	cppdb::ref_ptr<cppdb::backend::statement> s;
+	c=cppdb::driver_manager::instance().connect("dummy:@stmt_cache_size=2");
+	s=c->prepare("a");
+	s=c->prepare("b");
+	s=c->prepare("c");
+	s.reset();
+	cppdb::statement_cache_stats st = c->cache_stats();
+	TEST(st.misses==3 && st.hits==0 && st.evictions==1 && st.size==2 && st.capacity==2);
+	s=c->prepare("a");
+	s=c->prepare("c");
+	s.reset();
+	st = c->cache_stats();
+	TEST(st.hits==1 && st.misses==4 && st.evictions==2 && st.reprepares==1);
+	c.reset();
+
+	cppdb::pool::pointer p = cppdb::pool::create("dummy:@pool_size=2");
+	c=p->open();
+	s=c->prepare("x");
+	s.reset();
+	s=c->prepare("x");
+	s.reset();
+	c.reset();
+	c=p->open();
+	s=c->prepare("x");
+	s.reset();
+	c.reset();
+	cppdb::pool_stats ps = p->stats();
+	TEST(ps.statements.hits==2 && ps.statements.misses==1 && ps.statements.size==1);
+	p->clear();
+	TEST(dummy::connections==0);
+}
+
+void test_pool_affinity()
+{
+	cppdb::pool::pointer p = cppdb::pool::create("dummy:@pool_size=3");
+	cppdb::ref_ptr<cppdb::backend::connection> c1,c2,c3;
+	c1=p->open("a");
+	c2=p->open("b");
+	cppdb::backend::connection *p1=c1.get(),*p2=c2.get();
+	TEST(dummy::connections==2);
+	c1.reset();
+	c2.reset();
+	c3=p->open("a");
+	TEST(c3.get()==p1);
+	TEST(dummy::connections==2);
+	c3.reset();
+	c3=p->open("b");
+	TEST(c3.get()==p2);
+	c3.reset();
+	c3=p->open("c");
+	TEST(c3.get()==p2);
+	TEST(c3->affinity()=="c");
+	c3.reset();
+	c3=p->open();
+	TEST(c3.get()==p2);
+	TEST(c3->affinity()=="c");
+	c3.reset();
+	p->clear();
+	TEST(dummy::connections==0);
+}
+
+void test_pool_warmup()
+{
+	cppdb::pool::pointer p = cppdb::pool::create("dummy:@pool_size=3;@pool_warmup=2");
+	cppdb::ref_ptr<cppdb::backend::connection> c1,c2;
+	cppdb::ref_ptr<cppdb::backend::statement> s;
+	c1=p->open();
+	s=c1->prepare("test1");
+	s=c1->prepare("test2");
+	s=c1->prepare("test3");
+	s.reset();
+	TEST(dummy::statements==3);
+	c2=p->open();
+	TEST(dummy::statements==5);
+	s=c2->prepare("test3");
+	s=c2->prepare("test2");
+	TEST(dummy::statements==5);
+	s=c2->prepare("test1");
+	TEST(dummy::statements==6);
+	s.reset();
+	c1.reset();
+	c2.reset();
+	p->clear();
+	TEST(dummy::statements==0);
+	TEST(dummy::connections==0);
+}
+
+void test_pool_single_writer()
+{
+	cppdb::pool::pointer p = cppdb::pool::create("dummy:@pool_size=3;@pool_mode=single_writer");
+	cppdb::ref_ptr<cppdb::backend::connection> r,w;
+	r=p->open();
+	TEST(dummy::connections==2);
+	// the writer opened to set up the database is not a checkout
+	cppdb::pool_stats s = p->stats();
+	TEST(s.creates==2 && s.misses==1 && s.hits==0);
+	TEST(s.busy==1 && s.idle==1 && s.checkouts==1);
+	w=p->open_writer();
+	TEST(p->stats().hits==1);
+	TEST(w.get()!=r.get());
+	TEST(dummy::connections==2);
+	cppdb::backend::connection *first = w.get();
+	std::atomic<bool> got(false);
+	std::thread other([&]() {
+		cppdb::ref_ptr<cppdb::backend::connection> w2 = p->open_writer();
+		got = w2.get() == first;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	TEST(!got);
+	w.reset();
+	other.join();
+	TEST(got);
+	TEST(dummy::connections==2);
+	r.reset();
+	p->clear();
+	TEST(dummy::connections==0);
+}
+
+void test_pool_stats()
+{
+	cppdb::pool::pointer p = cppdb::pool::create("dummy:@pool_size=1");
+	cppdb::ref_ptr<cppdb::backend::connection> c1,c2;
+	c1=p->open();
+	c2=p->open();
+	cppdb::pool_stats s = p->stats();
+	TEST(s.misses==2 && s.hits==0 && s.creates==2);
+	TEST(s.busy==2 && s.idle==0);
+	TEST(s.checkouts==2);
+	TEST(s.checkout_p50 <= s.checkout_max);
+	c1.reset();
+	c2.reset();
+	s = p->stats();
+	TEST(s.busy==0 && s.idle==1);
+	TEST(s.destroys==1);
+	c1=p->open();
+	c1->recyclable(false);
+	c1.reset();
+	s = p->stats();
+	TEST(s.hits==1 && s.busy==0 && s.idle==0 && s.destroys==2);
+	p->clear();
+
+	// not pooled connections are not counted
+	p = cppdb::pool::create("dummy:@pool_size=0");
+	c1=p->open();
+	s = p->stats();
+	TEST(s.creates==0 && s.busy==0);
+	c1.reset();
+	s = p->stats();
+	TEST(s.destroys==0 && s.busy==0);
+
+	cppdb::connections_manager &mgr = cppdb::connections_manager::instance();
+	c1 = mgr.open("dummy:@pool_size=2");
+	std::map<std::string,cppdb::ref_ptr<cppdb::pool> > pools = mgr.pools();
+	TEST(pools.count("dummy:@pool_size=2")==1);
+	TEST(pools["dummy:@pool_size=2"]->stats().busy==1);
+	c1.reset();
+	pools["dummy:@pool_size=2"]->clear();
+	pools.clear();
+	mgr.gc();
+	TEST(mgr.pools().empty());
+	TEST(dummy::connections==0);
+}
+
 int main()
 {
 	try {
@@ -161,6 +331,26 @@ int main()
 		test_stmt_cache();
 	}
 	CATCH_BLOCK()
+	try {
+		test_stmt_cache_stats();
+	}
+	CATCH_BLOCK()
+	try {
+		test_pool_affinity();
+	}
+	CATCH_BLOCK()
+	try {
+		test_pool_warmup();
+	}
+	CATCH_BLOCK()
+	try {
+		test_pool_single_writer();
+	}
+	CATCH_BLOCK()
+	try {
+		test_pool_stats();
+	}
+	CATCH_BLOCK()
 	SUMMARY();
 
 }